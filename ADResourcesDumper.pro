@@ -18,10 +18,22 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
     AdDefinitions.cpp \
     AdMemoryHandler.cpp \
+    AdResourceIndex.cpp \
+    AdResourcePacker.cpp \
     AdResourceUnpacker.cpp \
     AdResourcesIterator.cpp \
     BinCdImageReader.cpp \
-    BitsReader.cpp \
+    CdEdcEcc.cpp \
+    CdImageLayout.cpp \
+    CdSectorVerifier.cpp \
+    CueSheet.cpp \
+    EcmImageDevice.cpp \
+    Iso9660Index.cpp \
+    MemoryPagesSnapshot.cpp \
+    MemoryStateFile.cpp \
+    RamAccessTracer.cpp \
+    SectorCache.cpp \
+    SectorPrefetcher.cpp \
     VirtualPsxRam.cpp \
     VirtualPsxVRam.cpp \
     main.cpp \
@@ -30,18 +42,32 @@ SOURCES += \
 HEADERS += \
     AdDefinitions.hpp \
     AdMemoryHandler.hpp \
+    AdResourceIndex.hpp \
+    AdResourcePacker.hpp \
     AdResourceUnpacker.hpp \
     AdResourcesIterator.hpp \
     AdSpeakerId.hpp \
     BinCdImageReader.hpp \
+    BitsBuffer.hpp \
     BitsHelper.hpp \
-    BitsReader.hpp \
+    CdEdcEcc.hpp \
+    CdImageLayout.hpp \
+    CdSectorVerifier.hpp \
+    CueSheet.hpp \
+    EcmImageDevice.hpp \
+    Iso9660Index.hpp \
     MainWindow.hpp \
     MemoryAddress.hpp \
+    MemoryPagesSnapshot.hpp \
+    MemoryStateFile.hpp \
     PsxRamAddress.hpp \
     PsxRamConst.hpp \
+    PsxRamView.hpp \
     PsxVRamConst.hpp \
     QLabelWithMouseEvents.hpp \
+    RamAccessTracer.hpp \
+    SectorCache.hpp \
+    SectorPrefetcher.hpp \
     VirtualPsxRam.hpp \
     VirtualPsxVRam.hpp
 
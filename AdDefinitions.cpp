@@ -1,5 +1,7 @@
 #include "AdDefinitions.hpp"
 
+constexpr char PsxExeHeader::ID[];
+
 GraphicFlags operator|(GraphicFlags one, GraphicFlags other)
 {
     using T = std::underlying_type<GraphicFlags>::type;
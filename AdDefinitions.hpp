@@ -4,6 +4,18 @@
 #include "PsxRamAddress.hpp"
 #include <QRect>
 
+struct PsxExeHeader
+{
+    static constexpr char ID[8] = {'P', 'S', '-', 'X', ' ', 'E', 'X', 'E'};
+
+    char id[8];
+    uint32_t zeroFilled[2];
+    PsxRamAddress initialPc;
+    PsxRamAddress initialGp;
+    PsxRamAddress textAddress;
+    uint32_t textSize;
+};
+
 enum class GameMode : uint16_t
 {
     None = 0,
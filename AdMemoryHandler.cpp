@@ -1,7 +1,52 @@
 #include "AdMemoryHandler.hpp"
-#include "AdResourcesIterator.hpp"
+#include "AdResourceIndex.hpp"
 #include "AdResourceUnpacker.hpp"
+#include "MemoryStateFile.hpp"
 #include <QPainter>
+#include <QRunnable>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+
+// Lets a function run on a thread pool also with Qt versions lacking
+// QThreadPool::start(std::function).
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(std::function<void()> function)
+        : function_{std::move(function)}
+    {}
+
+    void run() override
+    { function_(); }
+
+private:
+    std::function<void()> function_;
+};
+
+uint32_t calculateTextureSize(Rect const& textureRect)
+{
+    return static_cast<uint32_t>(textureRect.width) * textureRect.height *
+            PsxVRamConst::PIXEL_SIZE;
+}
+
+void assertUnpackedTextureSize(uint32_t unpackedSize, uint32_t textureSize)
+{
+    if (unpackedSize != textureSize)
+    {
+        throw QString(
+                    "Unpacked texture size 0x%1 does not match its rect "
+                    "size 0x%2.")
+                .arg(unpackedSize, 0, 16)
+                .arg(textureSize, 0, 16);
+    }
+}
+
+} // namespace
 
 const QPoint AdMemoryHandler::PORTRAIT_POSITION(0x54, 0x8d);
 constexpr SpeakerInfo AdMemoryHandler::INVALID_SPEAKER_INFO;
@@ -11,27 +56,179 @@ AdMemoryHandler::AdMemoryHandler()
       vram_{std::make_unique<VirtualPsxVRam>()}
 {}
 
+void AdMemoryHandler::setUnpackThreadsNumber(unsigned threadsNumber)
+{ unpackThreadsNumber_ = threadsNumber; }
+
+void AdMemoryHandler::setLazyRamLoading(bool isEnabled)
+{ isLazyRamLoadingEnabled_ = isEnabled; }
+
+void AdMemoryHandler::setRamAccessTracer(RamAccessTracer* accessTracer)
+{ ram_->setAccessTracer(accessTracer); }
+
 void AdMemoryHandler::loadCdImage(QString const& cdImagePath)
 {
     adCdImageReader_ = BinCdImageReader::create(cdImagePath);
     ram_->clear();
     vram_->clear();
+    loadBaseState(cdImagePath);
+    ram_->takeSnapshot();
+    vram_->takeSnapshot();
+}
+
+void AdMemoryHandler::loadBaseState(QString const& cdImagePath)
+{
+    static QString const STATE_FILE_SUFFIX(".memorystate");
+    auto stateFilePath = cdImagePath + STATE_FILE_SUFFIX;
+    auto const& imageFingerprint = adCdImageReader_->imageFingerprint();
+    auto createDataReader = [this](VirtualPsxRam::LazyDataId startSector) {
+        return createSectorsDataReader(startSector);
+    };
+    if (
+            MemoryStateFile::load(
+                stateFilePath,
+                imageFingerprint,
+                createDataReader,
+                isLazyRamLoadingEnabled_,
+                *ram_,
+                *vram_))
+    { return; }
     loadSlusTextSection();
     loadTownResources();
+    try
+    { MemoryStateFile::save(stateFilePath, imageFingerprint, *ram_, *vram_); }
+    catch (QString const&)
+    {
+        // Image directory may be read only. Base state will be loaded from
+        // image again on next open then.
+    }
+}
+
+void AdMemoryHandler::restoreBaseState()
+{
+    ram_->restoreSnapshot();
+    vram_->restoreSnapshot();
+}
+
+void AdMemoryHandler::switchGameMode(GameMode gameMode)
+{
+    restoreBaseState();
+    loadGameModeResources(gameMode);
 }
 
 void AdMemoryHandler::loadSlusTextSection()
 {
-    static constexpr uint32_t SLUS_TEXT_SECTION_START_SECTOR = 25;
-    static constexpr uint32_t SLUS_TEXT_SECTION_SIZE = 0x54800;
-    static constexpr PsxRamAddress::Raw SLUS_TEXT_SECTION_LOAD_ADDRESS =
-            0x8002d000;
-    ram_->load(
-                adCdImageReader_->readSectors(
+    auto const* bootExecutable = findBootExecutable();
+    if (bootExecutable == nullptr)
+    {
+        // No file system index, fall back to the US version layout.
+        static constexpr uint32_t SLUS_TEXT_SECTION_START_SECTOR = 25;
+        static constexpr uint32_t SLUS_TEXT_SECTION_SIZE = 0x54800;
+        static constexpr PsxRamAddress::Raw SLUS_TEXT_SECTION_LOAD_ADDRESS =
+                0x8002d000;
+        loadSectorsIntoRam(
                     SLUS_TEXT_SECTION_START_SECTOR,
                     BinCdImageReader::calculateSectorsNumber(
-                        SLUS_TEXT_SECTION_SIZE)),
-                SLUS_TEXT_SECTION_LOAD_ADDRESS);
+                        SLUS_TEXT_SECTION_SIZE),
+                    SLUS_TEXT_SECTION_LOAD_ADDRESS);
+        return;
+    }
+    auto executableHeader = adCdImageReader_->readSector(
+                bootExecutable->sector);
+    PsxExeHeader header;
+    std::memcpy(&header, executableHeader.constData(), sizeof(header));
+    if (std::memcmp(header.id, PsxExeHeader::ID, sizeof(header.id)) != 0)
+    {
+        throw QString("%1 is not a PSX executable.")
+                .arg(bootExecutable->path);
+    }
+    loadSectorsIntoRam(
+                bootExecutable->sector + 1,
+                BinCdImageReader::calculateSectorsNumber(header.textSize),
+                header.textAddress);
+}
+
+void AdMemoryHandler::loadSectorsIntoRam(
+        uint32_t startSector,
+        uint32_t sectorsNumber,
+        PsxRamAddress address)
+{
+    if (!isLazyRamLoadingEnabled_)
+    {
+        ram_->load(
+                    adCdImageReader_->readSectors(startSector, sectorsNumber),
+                    address);
+        return;
+    }
+    ram_->loadLazily(
+                address,
+                sectorsNumber * BinCdImageReader::DATA_IN_SECTOR_SIZE,
+                startSector,
+                createSectorsDataReader(startSector));
+}
+
+VirtualPsxRam::LazyDataReader AdMemoryHandler::createSectorsDataReader(
+        uint32_t startSector) const
+{
+    static constexpr uint32_t SECTOR_SIZE =
+            BinCdImageReader::DATA_IN_SECTOR_SIZE;
+    // RAM drops its readers when it is cleared for the next image, so
+    // the reader outlives them.
+    auto* cdImageReader = adCdImageReader_.get();
+    return [=](
+            uint32_t dataOffset,
+            uint8_t* buffer,
+            uint32_t size) {
+        uint32_t sector = startSector + dataOffset / SECTOR_SIZE;
+        uint32_t inSectorOffset = dataOffset % SECTOR_SIZE;
+        while (size > 0)
+        {
+            if (inSectorOffset == 0 && size >= SECTOR_SIZE)
+            {
+                uint32_t wholeSectorsNumber = size / SECTOR_SIZE;
+                cdImageReader->readSectors(sector, wholeSectorsNumber, buffer);
+                sector += wholeSectorsNumber;
+                buffer += wholeSectorsNumber * SECTOR_SIZE;
+                size -= wholeSectorsNumber * SECTOR_SIZE;
+                continue;
+            }
+            auto sectorView = cdImageReader->sectorView(sector);
+            uint32_t copiedSize = std::min(size, SECTOR_SIZE - inSectorOffset);
+            std::memcpy(buffer, sectorView.data + inSectorOffset, copiedSize);
+            ++sector;
+            inSectorOffset = 0;
+            buffer += copiedSize;
+            size -= copiedSize;
+        }
+    };
+}
+
+Iso9660Index::Entry const* AdMemoryHandler::findBootExecutable() const
+{
+    auto const& fileIndex = adCdImageReader_->fileIndex();
+    auto const* systemCnf = fileIndex.find("SYSTEM.CNF");
+    if (systemCnf == nullptr)
+    { return nullptr; }
+    auto systemCnfData = adCdImageReader_->readSectors(
+                systemCnf->sector,
+                systemCnf->sectorsNumber());
+    systemCnfData.truncate(systemCnf->size);
+    for (auto const& line : QString::fromLatin1(systemCnfData).split('\n'))
+    {
+        auto keyValueSeparator = line.indexOf('=');
+        if (
+                keyValueSeparator < 0 ||
+                line.left(keyValueSeparator).trimmed() != "BOOT")
+        { continue; }
+        auto bootPath = line.mid(keyValueSeparator + 1).trimmed();
+        auto const* bootExecutable = fileIndex.find(bootPath);
+        if (bootExecutable == nullptr)
+        {
+            throw QString("Boot executable %1 not found on disc.")
+                    .arg(bootPath);
+        }
+        return bootExecutable;
+    }
+    throw QString("No boot executable in SYSTEM.CNF.");
 }
 
 void AdMemoryHandler::loadTownResources()
@@ -42,24 +239,24 @@ void AdMemoryHandler::loadTownResources()
 
 void AdMemoryHandler::loadGameModeResources(GameMode gameMode)
 {
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "loadGameModeResources");
     auto gameModeData = readGameModeData(gameMode);
     if (gameModeData.memoryLoadInfoAddress.isNull())
     { return; }
     auto sectorsNumber = readGameModeDataSectorsNumber(gameMode);
-    MemoryLoadInfo memoryLoadInfo;
-    ram_->readRegion(
-                { gameModeData.memoryLoadInfoAddress, sizeof(MemoryLoadInfo)},
-                reinterpret_cast<uint8_t*>(&memoryLoadInfo));
+    auto memoryLoadInfo = ram_->viewObject<MemoryLoadInfo>(
+                gameModeData.memoryLoadInfoAddress);
     PsxRamAddress memoryLoadInfoAddress = memoryLoadInfo.address;
     if (memoryLoadInfoAddress.isNull())
     { throw QString("Address where to load resources is null."); }
     memoryLoadInfoAddress |= PsxRamConst::KSEG0_ADDRESS;
     sectorsNumber &= ~0x1ff;
     sectorsNumber |= memoryLoadInfo.sectorsNumber;
-    ram_->load(
-                adCdImageReader_->readSectors(
-                    memoryLoadInfo.sector,
-                    sectorsNumber),
+    loadSectorsIntoRam(
+                memoryLoadInfo.sector,
+                sectorsNumber,
                 memoryLoadInfoAddress);
 }
 
@@ -67,11 +264,7 @@ GameModeData AdMemoryHandler::readGameModeData(GameMode gameMode) const
 {
     PsxRamAddress gameModeDataAddress(0x8006ce44);
     gameModeDataAddress += gameModeToIndex(gameMode) * sizeof(GameModeData);
-    GameModeData gameModeData;
-    ram_->readRegion(
-                { gameModeDataAddress, sizeof(GameModeData) },
-                reinterpret_cast<uint8_t*>(&gameModeData));
-    return gameModeData;
+    return ram_->viewObject<GameModeData>(gameModeDataAddress);
 }
 
 uint32_t AdMemoryHandler::readGameModeDataSectorsNumber(GameMode gameMode)
@@ -84,63 +277,196 @@ uint32_t AdMemoryHandler::readGameModeDataSectorsNumber(GameMode gameMode)
 
 void AdMemoryHandler::loadTownVRamResources()
 {
-    MemoryLoadInfo townResourcesMemoryLoadInfo;
-    ram_->readRegion(
-                {0x80080ea0, sizeof(townResourcesMemoryLoadInfo)},
-                reinterpret_cast<uint8_t*>(&townResourcesMemoryLoadInfo));
-    auto townResourcesData = adCdImageReader_->readSectors(
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "loadTownVRamResources");
+    auto const& townResourcesMemoryLoadInfo =
+            ram_->viewObject<MemoryLoadInfo>(0x80080ea0);
+    auto townResourcesData = adCdImageReader_->sectorsView(
                 townResourcesMemoryLoadInfo.sector,
                 townResourcesMemoryLoadInfo.sectorsNumber);
-    AdResourcesIterator resourcesIterator(townResourcesData);
-    while (resourcesIterator.hasNext())
+    AdResourceIndex resourceIndex(
+                townResourcesData.data,
+                townResourcesData.size);
+    QVector<PackedTexture> packedTextures;
+    for (int index = 0; index < resourceIndex.entriesNumber(); ++index)
     {
-        auto nextResourceDescriptor = resourcesIterator.next();
-        auto const* resourceHeader = nextResourceDescriptor.header;
+        auto resourceDescriptor = resourceIndex.entry(index);
+        auto const* resourceHeader = resourceDescriptor.header;
         if (resourceHeader->type == ResourceType::VRamLoadablePackedImage)
         {
-            loadVRamLoadablePackedImage(
-                        reinterpret_cast<ResourceType1Header const*>(
-                            resourceHeader),
-                        nextResourceDescriptor.data,
-                        nextResourceDescriptor.size);
+            auto const* imageHeader =
+                    reinterpret_cast<ResourceType1Header const*>(
+                        resourceHeader);
+            packedTextures.append({
+                                      resourceDescriptor.data,
+                                      resourceDescriptor.size,
+                                      imageHeader->rect
+                                  });
+        }
+        else if (resourceHeader->type != ResourceType::Palette)
+        {
+            throw QString("Unexpected town resource type %1.")
+                    .arg(static_cast<uint16_t>(resourceHeader->type));
+        }
+    }
+    auto unpackedTextures = unpackTextures(packedTextures);
+    // Uploads keep bundle order, as resources may overlap in VRAM.
+    int textureIndex = 0;
+    for (int index = 0; index < resourceIndex.entriesNumber(); ++index)
+    {
+        auto resourceDescriptor = resourceIndex.entry(index);
+        auto const* resourceHeader = resourceDescriptor.header;
+        if (resourceHeader->type == ResourceType::VRamLoadablePackedImage)
+        {
+            loadPackedTexture(packedTextures, unpackedTextures, textureIndex);
+            ++textureIndex;
         }
-        else if (resourceHeader->type == ResourceType::Palette)
+        else
         {
             loadVRamPalette(
                         reinterpret_cast<ResourceType2Header const*>(
                             resourceHeader),
-                        nextResourceDescriptor.data);
+                        resourceDescriptor.data);
         }
-        else
+    }
+}
+
+QVector<AdMemoryHandler::UnpackedTexture> AdMemoryHandler::unpackTextures(
+        QVector<PackedTexture> const& packedTextures)
+{
+    auto threadsNumber = unpackThreadsNumber_;
+    if (threadsNumber == 0)
+    { threadsNumber = std::max(1u, std::thread::hardware_concurrency()); }
+    auto texturesNumber = static_cast<unsigned>(packedTextures.size());
+    if (threadsNumber > texturesNumber)
+    { threadsNumber = texturesNumber; }
+    if (threadsNumber <= 1)
+    { return {}; }
+    QVector<UnpackedTexture> unpackedTextures(packedTextures.size());
+    auto* unpackedTexturesData = unpackedTextures.data();
+    std::atomic<int> nextTextureIndex{0};
+    auto unpackNextTextures = [&]() {
+        for (
+             int index = nextTextureIndex++;
+             index < packedTextures.size();
+             index = nextTextureIndex++)
         {
-            throw QString("Unexpected town resource type %1.")
-                    .arg(static_cast<uint16_t>(resourceHeader->type));
+            auto const& packedTexture = packedTextures[index];
+            auto& unpackedTexture = unpackedTexturesData[index];
+            try
+            {
+                AdResourceUnpacker adResourceUnpacker(
+                            packedTexture.data,
+                            packedTexture.size);
+                auto textureSize = calculateTextureSize(packedTexture.rect);
+                unpackedTexture.data =
+                        QByteArray(textureSize, Qt::Uninitialized);
+                auto unpackedSize = adResourceUnpacker.unpack({
+                            reinterpret_cast<uint8_t*>(
+                                unpackedTexture.data.data()),
+                            textureSize,
+                            textureSize,
+                            1
+                        });
+                assertUnpackedTextureSize(unpackedSize, textureSize);
+            }
+            catch (...)
+            { unpackedTexture.error = std::current_exception(); }
         }
-    }
+    };
+    unpackThreadPool_.setMaxThreadCount(static_cast<int>(threadsNumber));
+    for (unsigned thread = 0; thread < threadsNumber; ++thread)
+    { unpackThreadPool_.start(new FunctionRunnable(unpackNextTextures)); }
+    unpackThreadPool_.waitForDone();
+    return unpackedTextures;
 }
 
-void AdMemoryHandler::loadVRamLoadablePackedImage(
-        ResourceType1Header const* resourceHeader,
-        uint8_t const* resourceData,
-        uint32_t maxSize)
+void AdMemoryHandler::loadPackedTexture(
+        QVector<PackedTexture> const& packedTextures,
+        QVector<UnpackedTexture> const& unpackedTextures,
+        int textureIndex)
 {
-    auto resourceTexture = unpackResourceTexture(resourceData, maxSize);
-    vram_->load(resourceTexture, resourceHeader->rect.toQRect());
+    auto const& packedTexture = packedTextures[textureIndex];
+    if (unpackedTextures.isEmpty())
+    {
+        unpackTextureIntoVRam(
+                    packedTexture.data,
+                    packedTexture.size,
+                    packedTexture.rect);
+        return;
+    }
+    auto const& unpackedTexture = unpackedTextures[textureIndex];
+    if (unpackedTexture.error)
+    { std::rethrow_exception(unpackedTexture.error); }
+    vram_->load(unpackedTexture.data, packedTexture.rect.toQRect());
 }
 
-QByteArray AdMemoryHandler::unpackResourceTexture(
+void AdMemoryHandler::unpackTextureIntoVRam(
         uint8_t const* resourceData,
-        uint32_t maxSize)
+        uint32_t maxSize,
+        Rect const& textureRect)
 {
     AdResourceUnpacker adResourceUnpacker(resourceData, maxSize);
-    uint32_t outBufferSize =
-            (maxSize / BinCdImageReader::DATA_IN_SECTOR_SIZE) *
+    // Stream is validated while it is unpacked, VRAM restores the rect when
+    // a corrupt or short texture throws.
+    vram_->load(
+                textureRect.toQRect(),
+                [&](uint8_t* rectData, uint32_t rowStride) {
+        auto unpackedSize = adResourceUnpacker.unpack({
+                    rectData,
+                    static_cast<uint32_t>(textureRect.width) *
+                        PsxVRamConst::PIXEL_SIZE,
+                    rowStride,
+                    textureRect.height
+                });
+        assertUnpackedTextureSize(
+                    unpackedSize,
+                    calculateTextureSize(textureRect));
+    });
+}
+
+void AdMemoryHandler::streamTextureIntoVRam(
+        uint32_t bundleStartSector,
+        uint32_t dataOffset,
+        uint32_t dataSize,
+        Rect const& textureRect)
+{
+    static constexpr uint32_t SECTOR_SIZE =
             BinCdImageReader::DATA_IN_SECTOR_SIZE;
-    if (maxSize % BinCdImageReader::DATA_IN_SECTOR_SIZE != 0)
-    { outBufferSize += BinCdImageReader::DATA_IN_SECTOR_SIZE; }
-    outBufferSize *= 2;
-    adResourceUnpacker.setOutBufferSize(outBufferSize);
-    return adResourceUnpacker.unpack();
+    AdResourceUnpacker adResourceUnpacker;
+    // VRAM restores the rect when a corrupt or short texture throws.
+    vram_->load(
+                textureRect.toQRect(),
+                [&](uint8_t* rectData, uint32_t rowStride) {
+        adResourceUnpacker.beginStream({
+                    rectData,
+                    static_cast<uint32_t>(textureRect.width) *
+                        PsxVRamConst::PIXEL_SIZE,
+                    rowStride,
+                    textureRect.height
+                });
+        uint32_t sector = bundleStartSector + dataOffset / SECTOR_SIZE;
+        uint32_t inSectorOffset = dataOffset % SECTOR_SIZE;
+        uint32_t leftDataSize = dataSize;
+        bool isStreamEnded = false;
+        while (leftDataSize > 0 && !isStreamEnded)
+        {
+            auto sectorView = adCdImageReader_->sectorView(sector);
+            uint32_t chunkSize = std::min(
+                        leftDataSize,
+                        SECTOR_SIZE - inSectorOffset);
+            isStreamEnded = adResourceUnpacker.feedStream(
+                        sectorView.data + inSectorOffset,
+                        chunkSize);
+            ++sector;
+            inSectorOffset = 0;
+            leftDataSize -= chunkSize;
+        }
+        assertUnpackedTextureSize(
+                    adResourceUnpacker.finishStream(),
+                    calculateTextureSize(textureRect));
+    });
 }
 
 void AdMemoryHandler::loadVRamPalette(
@@ -166,6 +492,9 @@ void AdMemoryHandler::loadVRamPalette(
 CharacterPortraitsData AdMemoryHandler::readCharacterPortraitsData(
         AdSpeakerId speakerId)
 {
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "readCharacterPortraitsData");
     auto const& speakerInfo = findSpeakerInfo(speakerId);
     if (!speakerInfo.isValid())
     { return {}; }
@@ -179,28 +508,52 @@ CharacterPortraitsData AdMemoryHandler::readCharacterPortraitsData(
     if (portraitDataTableAddress.isNull())
     { return {}; }
     CharacterPortraitsData characterPortraitsData;
-    PsxRamAddress portraitDataAddress = portraitDataTableAddress;
+    auto isLastPortraitData = [](PortraitData const& portraitData) {
+        return portraitData.portraitMemoryLoadInfoAddress.isNull();
+    };
+    auto portraitsData = ram().viewTable<PortraitData>(
+                portraitDataTableAddress,
+                isLastPortraitData,
+                speakerInfo.variantsNumber);
     for (
          uint32_t variantIndex = 0;
-         variantIndex < speakerInfo.variantsNumber;
+         variantIndex < portraitsData.size();
          ++variantIndex)
     {
-        CharacterPortraitData characterPortraitData;
-        auto& portraitData = characterPortraitData.portraitData;
-        ram().readRegion(
-                    {portraitDataAddress, sizeof(portraitData)},
-                    reinterpret_cast<uint8_t*>(&portraitData));
-        if (portraitData.portraitMemoryLoadInfoAddress.isNull())
+        auto const& portraitData = portraitsData[variantIndex];
+        if (isLastPortraitData(portraitData))
         { break; }
-        characterPortraitData.portraitDataAddress = portraitDataAddress;
-        characterPortraitsData.append(characterPortraitData);
-        portraitDataAddress += sizeof(PortraitData);
+        characterPortraitsData.append({
+                                          portraitsData.address(variantIndex),
+                                          portraitData
+                                      });
     }
     return characterPortraitsData;
 }
 
+void AdMemoryHandler::prefetchCharacterPortraits(
+        CharacterPortraitsData const& characterPortraitsData)
+{
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "prefetchCharacterPortraits");
+    adCdImageReader_->cancelPrefetches();
+    for (auto const& characterPortraitData : characterPortraitsData)
+    {
+        auto const& memoryLoadInfo = ram_->viewObject<MemoryLoadInfo>(
+                    characterPortraitData.portraitData
+                        .portraitMemoryLoadInfoAddress);
+        adCdImageReader_->prefetchSectors(
+                    memoryLoadInfo.sector,
+                    memoryLoadInfo.sectorsNumber);
+    }
+}
+
 uint8_t AdMemoryHandler::readSpeakerPortraitIndex(AdSpeakerId speakerId)
 {
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "readSpeakerPortraitIndex");
     static constexpr uint8_t SPEAKERS_WITH_PORTRAIT_NUMBER = 18;
     PsxRamAddress speakersWithPortraitsAddress = 0x8006b1ec;
     for (uint8_t index = 0; index < SPEAKERS_WITH_PORTRAIT_NUMBER; ++index)
@@ -226,15 +579,14 @@ SpeakerInfo const& AdMemoryHandler::findSpeakerInfo(AdSpeakerId speakerId) const
 CharacterPortraitResource AdMemoryHandler::loadCharacterPortrait(
         PortraitData portraitData)
 {
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "loadCharacterPortrait");
     CharacterPortraitResource characterPortraitResource;
     MemoryLoadInfo& memoryLoadInfo =
             characterPortraitResource.resourcesMemoryLoadInfo;
-    ram().readRegion(
-                {
-                    portraitData.portraitMemoryLoadInfoAddress,
-                    sizeof(memoryLoadInfo)
-                },
-                reinterpret_cast<uint8_t*>(&memoryLoadInfo));
+    memoryLoadInfo = ram().viewObject<MemoryLoadInfo>(
+                portraitData.portraitMemoryLoadInfoAddress);
     loadPortraitResourceIntoVRam(memoryLoadInfo);
     characterPortraitResource.animationFrames =
             readAnimation(portraitData.animationAddress);
@@ -247,81 +599,122 @@ CharacterPortraitResource AdMemoryHandler::loadCharacterPortrait(
 void AdMemoryHandler::loadPortraitResourceIntoVRam(
         MemoryLoadInfo const& memoryLoadInfo)
 {
-    auto portraitTextureResource = adCdImageReader_->readSectors(
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "loadPortraitResourceIntoVRam");
+    // Bundle of a streamed image would be read whole just to be unpacked, so
+    // only its headers are read and textures are streamed sector by sector.
+    bool isStreamed = !adCdImageReader_->isMemoryMapped();
+    uint32_t bundleSize =
+            memoryLoadInfo.sectorsNumber *
+            BinCdImageReader::DATA_IN_SECTOR_SIZE;
+    uint32_t viewedSectorsNumber = memoryLoadInfo.sectorsNumber;
+    if (isStreamed)
+    { viewedSectorsNumber = std::min(viewedSectorsNumber, 1u); }
+    auto portraitTextureResource = adCdImageReader_->sectorsView(
                 memoryLoadInfo.sector,
-                memoryLoadInfo.sectorsNumber);
-    AdResourcesIterator resourcesIterator(portraitTextureResource);
-    int portraitImageIndex = 0;
-    while (resourcesIterator.hasNext())
+                viewedSectorsNumber);
+    if (isStreamed)
     {
-        if (portraitImageIndex > 2)
+        auto headersSize = std::min(
+                    AdResourceIndex::calculateHeadersSize(
+                        portraitTextureResource.data,
+                        portraitTextureResource.size),
+                    bundleSize);
+        auto headersSectorsNumber =
+                BinCdImageReader::calculateSectorsNumber(headersSize);
+        if (headersSectorsNumber > viewedSectorsNumber)
         {
-            throw QString(
-                        "Max number of resources (2) per portrait resources "
-                        "excedeed.");
+            portraitTextureResource = adCdImageReader_->sectorsView(
+                        memoryLoadInfo.sector,
+                        headersSectorsNumber);
         }
-        Rect portraitTextureRect;
-        ram_->readRegion(
-                    {
-                        0x8006b220 +
-                        portraitImageIndex * sizeof(portraitTextureRect),
-                        sizeof (portraitTextureRect)
-                    },
-                    reinterpret_cast<uint8_t*>(&portraitTextureRect));
-        auto nextResourceDescriptor = resourcesIterator.next();
-        auto const* resourceHeader = nextResourceDescriptor.header;
-        auto const* resourceData = nextResourceDescriptor.data;
-        auto resourceSize = nextResourceDescriptor.size;
-        if (resourceHeader->type == ResourceType::PackedImage)
-        {
-            auto resourceTexture =
-                    unpackResourceTexture(resourceData, resourceSize);
-            vram().load(
-                        resourceTexture,
-                        portraitTextureRect.toQRect());
-        }
-        else
+    }
+    AdResourceIndex resourceIndex(
+                portraitTextureResource.data,
+                portraitTextureResource.size,
+                bundleSize);
+    if (resourceIndex.entriesNumber() > 3)
+    {
+        throw QString(
+                    "Max number of resources (2) per portrait resources "
+                    "excedeed.");
+    }
+    auto portraitTexturesRects = ram_->view<Rect>(
+                0x8006b220,
+                resourceIndex.entriesNumber());
+    for (int index = 0; index < resourceIndex.entriesNumber(); ++index)
+    {
+        auto const* resourceHeader = resourceIndex.header(index);
+        if (resourceHeader->type != ResourceType::PackedImage)
         {
             throw QString("Unexpected portrait resource type %1.")
                     .arg(static_cast<uint16_t>(resourceHeader->type));
         }
-        ++portraitImageIndex;
     }
+    if (isStreamed)
+    {
+        for (int index = 0; index < resourceIndex.entriesNumber(); ++index)
+        {
+            streamTextureIntoVRam(
+                        memoryLoadInfo.sector,
+                        resourceIndex.dataOffset(index),
+                        resourceIndex.dataSize(index),
+                        portraitTexturesRects[index]);
+        }
+        return;
+    }
+    QVector<PackedTexture> packedTextures;
+    for (int index = 0; index < resourceIndex.entriesNumber(); ++index)
+    {
+        auto resourceDescriptor = resourceIndex.entry(index);
+        packedTextures.append({
+                                  resourceDescriptor.data,
+                                  resourceDescriptor.size,
+                                  portraitTexturesRects[index]
+                              });
+    }
+    auto unpackedTextures = unpackTextures(packedTextures);
+    for (int index = 0; index < packedTextures.size(); ++index)
+    { loadPackedTexture(packedTextures, unpackedTextures, index); }
 }
 
 AnimationFrames AdMemoryHandler::readAnimation(PsxRamAddress animationAddress)
 {
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "readAnimation");
     AnimationFrames animationFrames;
-    AnimationFrame animationFrame;
-    auto& animation = animationFrame.first;
-    while (true)
+    auto isLastAnimation = [](Animation const& animation) {
+        return animation.frameType != AnimationFrameType::NotLastFrame;
+    };
+    auto animations = ram().viewTable<Animation>(
+                animationAddress,
+                isLastAnimation);
+    for (auto const& animation : animations)
     {
-        ram().readRegion(
-                    { animationAddress, sizeof(animation) },
-                    reinterpret_cast<uint8_t*>(&animation));
-        if (animation.frameType != AnimationFrameType::NotLastFrame)
+        if (isLastAnimation(animation))
         { break; }
-        animationFrame.second = readGraphicsSeries(animation.graphicAddress);
-        animationFrames.append(animationFrame);
-        animationAddress += sizeof(Animation);
+        animationFrames.append({
+                                   animation,
+                                   readGraphicsSeries(animation.graphicAddress)
+                               });
     }
     return animationFrames;
 }
 
 GraphicsSeries AdMemoryHandler::readGraphicsSeries(PsxRamAddress graphicAddress)
 {
+    RamAccessTracer::OperationScope traceScope(
+                ram_->accessTracer(),
+                "readGraphicsSeries");
     GraphicsSeries graphicsSeries;
-    Graphic graphic;
-    do
-    {
-        ram_->readRegion(
-                    {graphicAddress, sizeof(graphic)},
-                    reinterpret_cast<uint8_t*>(&graphic));
-        auto graphicImage = readGraphic(graphic);
-        graphicsSeries.append({graphic, graphicImage});
-        graphicAddress += sizeof(Graphic);
-    }
-    while (!graphic.hasFlags(GraphicFlags::SeriesEnd));
+    auto isLastGraphic = [](Graphic const& graphic) {
+        return graphic.hasFlags(GraphicFlags::SeriesEnd);
+    };
+    auto graphics = ram_->viewTable<Graphic>(graphicAddress, isLastGraphic);
+    for (auto const& graphic : graphics)
+    { graphicsSeries.append({graphic, readGraphic(graphic)}); }
     return graphicsSeries;
 }
 
@@ -7,7 +7,9 @@
 #include "VirtualPsxRam.hpp"
 #include "VirtualPsxVRam.hpp"
 #include <QImage>
+#include <QThreadPool>
 #include <QVector>
+#include <exception>
 #include <memory>
 
 struct CharacterPortraitData
@@ -67,9 +69,36 @@ class AdMemoryHandler
     static constexpr SpeakerInfo INVALID_SPEAKER_INFO =
         {nullptr, AdSpeakerId::None, 0};
 
+    struct PackedTexture
+    {
+        uint8_t const* data;
+        uint32_t size;
+        Rect rect;
+    };
+
+    struct UnpackedTexture
+    {
+        QByteArray data;
+        // Rethrown when texture is uploaded, so textures and palettes
+        // preceding it are uploaded as with serial unpacking.
+        std::exception_ptr error;
+    };
+
 public:
     AdMemoryHandler();
 
+    // Packed textures of a resources bundle are unpacked on threadsNumber
+    // threads of a pool kept for the handler's lifetime (0 means one per
+    // hardware thread). Parallel unpacking goes through intermediate
+    // buffers, so the default 1 unpacks them serially straight into VRAM.
+    void setUnpackThreadsNumber(unsigned threadsNumber);
+    // When enabled (default), data loaded from disc into RAM is read page by
+    // page on first access. Takes effect with the next loaded image.
+    void setLazyRamLoading(bool isEnabled);
+    // Traces RAM accesses tagged with name of the operation which made them.
+    // Null tracer disables tracing.
+    void setRamAccessTracer(RamAccessTracer* accessTracer);
+
     VirtualPsxRam const& ram() const
     { return *ram_; }
     VirtualPsxVRam const& vram() const
@@ -83,9 +112,17 @@ public:
     // TODO: remove them?
     BinCdImageReader* adCdImageReader()
     { return adCdImageReader_.get(); }
+    // Loads SLUS and town resources, then snapshots both memories as the
+    // base state.
     void loadCdImage(QString const& cdImagePath);
+    // Reverts pages written to RAM and VRAM since the image was loaded.
+    void restoreBaseState();
+    // Loads game mode resources on top of the base state.
+    void switchGameMode(GameMode gameMode);
     void loadGameModeResources(GameMode gameMode);
     CharacterPortraitsData readCharacterPortraitsData(AdSpeakerId speakerId);
+    void prefetchCharacterPortraits(
+            CharacterPortraitsData const& characterPortraitsData);
     CharacterPortraitResource loadCharacterPortrait(PortraitData portraitData);
     AnimationFrames readAnimation(PsxRamAddress animationAddress);
     GraphicsSeries readGraphicsSeries(PsxRamAddress graphicAddress);
@@ -104,20 +141,43 @@ public:
             QSize const& size);
 
 private:
+    // Loads SLUS and town resources, from state file persisted next to the
+    // image if there is one.
+    void loadBaseState(QString const& cdImagePath);
     void loadSlusTextSection();
+    void loadSectorsIntoRam(
+            uint32_t startSector,
+            uint32_t sectorsNumber,
+            PsxRamAddress address);
+    // Reads data stored in consecutive sectors starting at startSector.
+    VirtualPsxRam::LazyDataReader createSectorsDataReader(
+            uint32_t startSector) const;
+    Iso9660Index::Entry const* findBootExecutable() const;
     void loadTownResources();
     GameModeData readGameModeData(GameMode gameMode) const;
     uint32_t readGameModeDataSectorsNumber(GameMode gameMode);
     uint32_t gameModeToIndex(GameMode gameMode) const
     { return static_cast<uint32_t>(gameMode); }
     void loadTownVRamResources();
-    void loadVRamLoadablePackedImage(
-            ResourceType1Header const* resourceHeader,
-            uint8_t const* resourceData,
-            uint32_t maxSize);
-    QByteArray unpackResourceTexture(
+    // Returns textures unpacked in parallel, or no textures if they should be
+    // unpacked serially.
+    QVector<UnpackedTexture> unpackTextures(
+            QVector<PackedTexture> const& packedTextures);
+    void loadPackedTexture(
+            QVector<PackedTexture> const& packedTextures,
+            QVector<UnpackedTexture> const& unpackedTextures,
+            int textureIndex);
+    void unpackTextureIntoVRam(
             uint8_t const* resourceData,
-            uint32_t maxSize);
+            uint32_t maxSize,
+            Rect const& textureRect);
+    // Feeds packed texture to unpacker sector by sector straight into its
+    // rect, data starts dataOffset bytes from bundle start.
+    void streamTextureIntoVRam(
+            uint32_t bundleStartSector,
+            uint32_t dataOffset,
+            uint32_t dataSize,
+            Rect const& textureRect);
     void loadVRamPalette(
             ResourceType2Header const* resourceHeader,
             uint8_t const* resourceData);
@@ -139,6 +199,9 @@ private:
     std::unique_ptr<VirtualPsxRam> ram_;
     std::unique_ptr<VirtualPsxVRam> vram_;
     std::unique_ptr<BinCdImageReader> adCdImageReader_;
+    unsigned unpackThreadsNumber_{1};
+    QThreadPool unpackThreadPool_;
+    bool isLazyRamLoadingEnabled_{true};
 };
 
 #endif // ADMEMORYHANDLER_HPP
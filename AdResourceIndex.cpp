@@ -0,0 +1,208 @@
+#include "AdResourceIndex.hpp"
+#include "AdResourceUnpacker.hpp"
+#include "PsxVRamConst.hpp"
+#include <algorithm>
+
+namespace
+{
+
+static constexpr int KNOWN_TYPES_NUMBER =
+        static_cast<int>(ResourceType::PackedImage) + 1;
+
+inline int typeToIndex(ResourceType type)
+{ return static_cast<int>(type); }
+
+} // namespace
+
+AdResourceIndex::AdResourceIndex(QByteArray const& resourcesData)
+    : resourcesData_{resourcesData},
+      data_{reinterpret_cast<uint8_t const*>(resourcesData_.constData())},
+      size_{static_cast<uint32_t>(resourcesData_.size())},
+      bundleSize_{size_},
+      typesEntries_(KNOWN_TYPES_NUMBER)
+{ build(); }
+
+AdResourceIndex::AdResourceIndex(
+        uint8_t const* resourcesData,
+        uint32_t size)
+    : AdResourceIndex(resourcesData, size, size)
+{}
+
+AdResourceIndex::AdResourceIndex(
+        uint8_t const* headersData,
+        uint32_t headersSize,
+        uint32_t bundleSize)
+    : data_{headersData},
+      size_{std::min(headersSize, bundleSize)},
+      bundleSize_{bundleSize},
+      typesEntries_(KNOWN_TYPES_NUMBER)
+{ build(); }
+
+uint32_t AdResourceIndex::calculateHeadersSize(
+        uint8_t const* data,
+        uint32_t size)
+{
+    auto const* header = reinterpret_cast<ResourceHeader const*>(data);
+    if (size >= sizeof(ResourceType) && header->type == ResourceType::None)
+    { return sizeof(ResourceType); }
+    if (size < sizeof(ResourceHeader))
+    { throw QString("Resource 0 header at 0x0 is invalid."); }
+    return header->dataStartOffset;
+}
+
+int AdResourceIndex::entriesNumber() const
+{ return entries_.size(); }
+
+int AdResourceIndex::entriesNumber(ResourceType type) const
+{
+    auto typeIndex = typeToIndex(type);
+    if (typeIndex >= typesEntries_.size())
+    { return 0; }
+    return typesEntries_[typeIndex].size();
+}
+
+AdResourceDescriptor AdResourceIndex::entry(int index) const
+{
+    assertEntryIndex(index);
+    auto const& entry = entries_[index];
+    if (entry.dataOffset + entry.dataSize > size_)
+    {
+        throw QString("Resource %1 data is not in indexed bundle part.")
+                .arg(index);
+    }
+    return {
+        reinterpret_cast<ResourceHeader const*>(data_ + entry.headerOffset),
+        data_ + entry.dataOffset,
+        entry.dataSize
+    };
+}
+
+AdResourceDescriptor AdResourceIndex::entry(
+        ResourceType type,
+        int typeIndex) const
+{
+    if (typeIndex < 0 || typeIndex >= entriesNumber(type))
+    {
+        throw QString("No resource %1 of type %2 in bundle.")
+                .arg(typeIndex)
+                .arg(static_cast<uint16_t>(type));
+    }
+    return entry(typesEntries_[typeToIndex(type)][typeIndex]);
+}
+
+ResourceHeader const* AdResourceIndex::header(int index) const
+{
+    assertEntryIndex(index);
+    return reinterpret_cast<ResourceHeader const*>(
+                data_ + entries_[index].headerOffset);
+}
+
+uint32_t AdResourceIndex::dataOffset(int index) const
+{
+    assertEntryIndex(index);
+    return entries_[index].dataOffset;
+}
+
+uint32_t AdResourceIndex::dataSize(int index) const
+{
+    assertEntryIndex(index);
+    return entries_[index].dataSize;
+}
+
+QByteArray AdResourceIndex::unpack(int index) const
+{
+    auto resourceDescriptor = entry(index);
+    auto type = resourceDescriptor.header->type;
+    if (
+            type != ResourceType::VRamLoadablePackedImage &&
+            type != ResourceType::PackedImage)
+    {
+        throw QString("Resource %1 of type %2 is not packed.")
+                .arg(index)
+                .arg(static_cast<uint16_t>(type));
+    }
+    AdResourceUnpacker adResourceUnpacker(
+                resourceDescriptor.data,
+                resourceDescriptor.size);
+    if (type == ResourceType::VRamLoadablePackedImage)
+    {
+        auto const& rect = reinterpret_cast<ResourceType1Header const*>(
+                    resourceDescriptor.header)->rect;
+        adResourceUnpacker.setOutBufferSize(
+                    static_cast<uint32_t>(rect.width) *
+                    rect.height *
+                    PsxVRamConst::PIXEL_SIZE);
+    }
+    return adResourceUnpacker.unpack();
+}
+
+void AdResourceIndex::build()
+{
+    uint32_t headerOffset = 0;
+    uint32_t previousDataOffset = 0;
+    while (true)
+    {
+        if (size_ - headerOffset < sizeof(ResourceType))
+        { throw QString("Resources bundle has no terminating header."); }
+        auto const* header =
+                reinterpret_cast<ResourceHeader const*>(data_ + headerOffset);
+        if (header->type == ResourceType::None)
+        { break; }
+        auto index = entries_.size();
+        if (
+                size_ - headerOffset < sizeof(ResourceHeader) ||
+                header->headerSize < minHeaderSize(header->type) ||
+                header->headerSize > size_ - headerOffset)
+        {
+            throw QString("Resource %1 header at 0x%2 is invalid.")
+                    .arg(index)
+                    .arg(headerOffset, 0, 16);
+        }
+        if (
+                header->dataStartOffset > bundleSize_ ||
+                header->dataStartOffset < previousDataOffset)
+        {
+            throw QString("Resource %1 data offset 0x%2 is invalid.")
+                    .arg(index)
+                    .arg(header->dataStartOffset, 0, 16);
+        }
+        entries_.append({headerOffset, header->dataStartOffset, 0});
+        auto typeIndex = typeToIndex(header->type);
+        if (typeIndex < typesEntries_.size())
+        { typesEntries_[typeIndex].append(index); }
+        previousDataOffset = header->dataStartOffset;
+        headerOffset += header->headerSize;
+    }
+    for (int index = 0; index < entries_.size(); ++index)
+    {
+        auto dataEnd = index + 1 < entries_.size() ?
+                    entries_[index + 1].dataOffset :
+                    bundleSize_;
+        entries_[index].dataSize = dataEnd - entries_[index].dataOffset;
+    }
+}
+
+uint32_t AdResourceIndex::minHeaderSize(ResourceType type)
+{
+    switch (type)
+    {
+    case ResourceType::VRamLoadablePackedImage:
+        return sizeof(ResourceType1Header);
+    case ResourceType::Palette:
+        return sizeof(ResourceType2Header);
+    case ResourceType::PackedImage:
+        return sizeof(ResourceType3Header);
+    default:
+        return sizeof(ResourceHeader);
+    }
+}
+
+void AdResourceIndex::assertEntryIndex(int index) const
+{
+    if (index < 0 || index >= entries_.size())
+    {
+        throw QString("Resource index %1 is out of bundle range (%2).")
+                .arg(index)
+                .arg(entries_.size());
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef ADRESOURCEINDEX_HPP
+#define ADRESOURCEINDEX_HPP
+
+#include "AdResourcesIterator.hpp"
+#include <QByteArray>
+#include <QVector>
+#include <cstdint>
+
+// Random access index of a resources bundle. Bundle is walked once, every
+// header is validated against bundle bounds and compact descriptors of
+// entries are kept, so entries can be looked up by position or by type
+// without rescanning.
+class AdResourceIndex
+{
+    struct Entry
+    {
+        uint32_t headerOffset;
+        uint32_t dataOffset;
+        uint32_t dataSize;
+    };
+
+public:
+    AdResourceIndex(QByteArray const& resourcesData);
+    // resourcesData has to outlive the index.
+    AdResourceIndex(uint8_t const* resourcesData, uint32_t size);
+    // Indexes bundle of bundleSize bytes from its first headersSize bytes
+    // holding all headers, so data of entries can be read from elsewhere,
+    // e.g. streamed from sectors. Only entries whose data lies in indexed
+    // bytes can be accessed with entry().
+    AdResourceIndex(
+            uint8_t const* headersData,
+            uint32_t headersSize,
+            uint32_t bundleSize);
+
+    // Size of bundle part holding all headers. Data of entries follows
+    // headers, so it's taken from the first header, which data has to hold.
+    static uint32_t calculateHeadersSize(uint8_t const* data, uint32_t size);
+
+    int entriesNumber() const;
+    int entriesNumber(ResourceType type) const;
+    AdResourceDescriptor entry(int index) const;
+    AdResourceDescriptor entry(ResourceType type, int typeIndex) const;
+    ResourceHeader const* header(int index) const;
+    // Offset of entry data from bundle start.
+    uint32_t dataOffset(int index) const;
+    uint32_t dataSize(int index) const;
+    // Unpacks packed image entry on demand. Unpacked size of VRAM loadable
+    // images comes from their rect, other images are scanned first.
+    QByteArray unpack(int index) const;
+
+private:
+    void build();
+    static uint32_t minHeaderSize(ResourceType type);
+    void assertEntryIndex(int index) const;
+
+    QByteArray resourcesData_;
+    uint8_t const* data_;
+    uint32_t size_;
+    uint32_t bundleSize_;
+    QVector<Entry> entries_;
+    // Entries indices by type, known types only.
+    QVector<QVector<int>> typesEntries_;
+};
+
+#endif // ADRESOURCEINDEX_HPP
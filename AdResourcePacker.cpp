@@ -0,0 +1,276 @@
+#include "AdResourcePacker.hpp"
+#include "BitsHelper.hpp"
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace
+{
+
+// Lets a function run on a thread pool also with Qt versions lacking
+// QThreadPool::start(std::function).
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(std::function<void()> function)
+        : function_{std::move(function)}
+    {}
+
+    void run() override
+    { function_(); }
+
+private:
+    std::function<void()> function_;
+};
+
+struct LevelParameters
+{
+    uint32_t maxChainLength;
+    uint32_t niceMatchLength;
+    bool isLazy;
+};
+
+LevelParameters levelParameters(AdResourcePacker::Level level)
+{
+    switch (level)
+    {
+    case AdResourcePacker::Level::Fastest:
+        return { 8, 0x20, false };
+    case AdResourcePacker::Level::Smallest:
+        return { 0x1000, 0x100, true };
+    default:
+        return { 0x40, 0x80, true };
+    }
+}
+
+inline uint32_t prefixKey(uint8_t const* data)
+{ return (static_cast<uint32_t>(data[0]) << 8) | data[1]; }
+
+} // namespace
+
+constexpr uint32_t AdResourcePacker::MAX_MATCH_LENGTH;
+constexpr int32_t AdResourcePacker::NO_POSITION;
+
+AdResourcePacker::AdResourcePacker(Level level)
+    : chainHeads_(valuesInBits(16), NO_POSITION)
+{
+    auto parameters = levelParameters(level);
+    maxChainLength_ = parameters.maxChainLength;
+    niceMatchLength_ = parameters.niceMatchLength;
+    isLazy_ = parameters.isLazy;
+}
+
+QByteArray AdResourcePacker::pack(QByteArray const& data)
+{
+    return pack(
+                reinterpret_cast<uint8_t const*>(data.constData()),
+                static_cast<uint32_t>(data.size()));
+}
+
+QByteArray AdResourcePacker::pack(uint8_t const* data, uint32_t size)
+{
+    resetInternalVariables(data, size);
+    uint32_t position = 0;
+    Match match{0, 0};
+    bool isMatchFound = false;
+    while (position < size_)
+    {
+        if (!isMatchFound)
+        {
+            insertPositionsUpTo(position);
+            match = findMatch(position);
+        }
+        isMatchFound = false;
+        if (
+                isLazy_ &&
+                isMatchUsable(match) &&
+                match.length < niceMatchLength_ &&
+                position + 1 < size_)
+        {
+            // Literal followed by a longer match is usually cheaper.
+            insertPositionsUpTo(position + 1);
+            auto nextMatch = findMatch(position + 1);
+            if (nextMatch.length > match.length)
+            {
+                writeLiteral(data_[position]);
+                ++position;
+                match = nextMatch;
+                isMatchFound = true;
+                continue;
+            }
+        }
+        if (isMatchUsable(match))
+        {
+            writeMatch(match);
+            position += match.length;
+        }
+        else
+        {
+            writeLiteral(data_[position]);
+            ++position;
+        }
+    }
+    writeEndMarker();
+    return packed_;
+}
+
+QVector<QByteArray> AdResourcePacker::packAll(
+        QVector<QByteArray> const& resources,
+        Level level,
+        unsigned threadsNumber)
+{
+    if (threadsNumber == 0)
+    { threadsNumber = std::max(1u, std::thread::hardware_concurrency()); }
+    auto resourcesNumber = static_cast<unsigned>(resources.size());
+    if (threadsNumber > resourcesNumber)
+    { threadsNumber = std::max(1u, resourcesNumber); }
+    QVector<QByteArray> packedResources(resources.size());
+    // Resources differ in size, so threads take next resource when done
+    // instead of getting equal shares upfront.
+    std::atomic<int> nextResourceIndex{0};
+    auto packResources = [&]() {
+        AdResourcePacker packer(level);
+        for (
+             int index = nextResourceIndex++;
+             index < resources.size();
+             index = nextResourceIndex++)
+        { packedResources[index] = packer.pack(resources[index]); }
+    };
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(static_cast<int>(threadsNumber));
+    for (unsigned thread = 0; thread < threadsNumber; ++thread)
+    { threadPool.start(new FunctionRunnable(packResources)); }
+    threadPool.waitForDone();
+    return packedResources;
+}
+
+void AdResourcePacker::resetInternalVariables(
+        uint8_t const* data,
+        uint32_t size)
+{
+    data_ = data;
+    size_ = size;
+    insertedPositionsNumber_ = 0;
+    std::fill(chainHeads_.begin(), chainHeads_.end(), NO_POSITION);
+    previousPositions_.assign(size_, NO_POSITION);
+    packed_.clear();
+    // Worst case is a literal per byte, 9 bits each.
+    packed_.reserve(size_ + size_ / BITS_IN_BYTE + 4);
+    controlBytePosition_ = 0;
+    controlByteBitIndex_ = BITS_IN_BYTE;
+}
+
+void AdResourcePacker::insertPositionsUpTo(uint32_t position)
+{
+    auto prefixesEnd = std::min(position, size_ > 0 ? size_ - 1 : 0);
+    for (; insertedPositionsNumber_ < prefixesEnd; ++insertedPositionsNumber_)
+    {
+        auto key = prefixKey(data_ + insertedPositionsNumber_);
+        previousPositions_[insertedPositionsNumber_] = chainHeads_[key];
+        chainHeads_[key] = static_cast<int32_t>(insertedPositionsNumber_);
+    }
+}
+
+AdResourcePacker::Match AdResourcePacker::findMatch(uint32_t position) const
+{
+    Match bestMatch{0, 0};
+    if (position + MIN_SHORT_MATCH_LENGTH > size_)
+    { return bestMatch; }
+    auto maxLength = std::min(MAX_MATCH_LENGTH, size_ - position);
+    auto const* current = data_ + position;
+    auto candidate = chainHeads_[prefixKey(current)];
+    for (
+         uint32_t chainLength = 0;
+         candidate != NO_POSITION && chainLength < maxChainLength_;
+         candidate = previousPositions_[candidate], ++chainLength)
+    {
+        auto offset = position - static_cast<uint32_t>(candidate);
+        if (offset > MAX_LONG_MATCH_OFFSET)
+        { break; }
+        auto const* previous = data_ + candidate;
+        // Prefix is equal already, unless it is a different prefix with
+        // colliding key, which never happens with two byte keys.
+        uint32_t length = MIN_SHORT_MATCH_LENGTH;
+        while (length < maxLength && previous[length] == current[length])
+        { ++length; }
+        if (length > bestMatch.length && isMatchUsable({length, offset}))
+        {
+            bestMatch = {length, offset};
+            if (length >= niceMatchLength_ || length == maxLength)
+            { break; }
+        }
+    }
+    return bestMatch;
+}
+
+bool AdResourcePacker::isMatchUsable(Match const& match)
+{
+    if (match.length >= MIN_LONG_MATCH_LENGTH)
+    { return true; }
+    return
+            match.length >= MIN_SHORT_MATCH_LENGTH &&
+            match.offset <= MAX_SHORT_MATCH_OFFSET;
+}
+
+void AdResourcePacker::writeLiteral(uint8_t byte)
+{
+    writeControlBit(0);
+    writeByte(byte);
+}
+
+void AdResourcePacker::writeMatch(Match const& match)
+{
+    writeControlBit(1);
+    if (
+            match.offset <= MAX_SHORT_MATCH_OFFSET &&
+            match.length <= MAX_SHORT_MATCH_LENGTH)
+    {
+        writeControlBit(1);
+        auto encodedLength = match.length - MIN_SHORT_MATCH_LENGTH;
+        writeControlBit((encodedLength >> 1) & 1);
+        writeControlBit(encodedLength & 1);
+        // Offset 0x100 is stored as 0.
+        writeByte(static_cast<uint8_t>(match.offset));
+        return;
+    }
+    writeControlBit(0);
+    bool hasLengthByte =
+            match.length < MIN_LONG_MATCH_LENGTH ||
+            match.length > MAX_NIBBLE_MATCH_LENGTH;
+    uint16_t offsetAndLength = static_cast<uint16_t>(match.offset << 4);
+    if (!hasLengthByte)
+    { offsetAndLength |= match.length - 2; }
+    writeByte(static_cast<uint8_t>(offsetAndLength >> 8));
+    writeByte(static_cast<uint8_t>(offsetAndLength));
+    if (hasLengthByte)
+    { writeByte(static_cast<uint8_t>(match.length - 1)); }
+}
+
+void AdResourcePacker::writeEndMarker()
+{
+    writeControlBit(1);
+    writeControlBit(0);
+    writeByte(0);
+    writeByte(0);
+}
+
+void AdResourcePacker::writeControlBit(uint8_t bit)
+{
+    // Unpacker reads next control byte when it needs a bit, so the byte is
+    // placed at the current output position.
+    if (controlByteBitIndex_ >= BITS_IN_BYTE)
+    {
+        controlBytePosition_ = packed_.size();
+        packed_.append('\0');
+        controlByteBitIndex_ = 0;
+    }
+    if (bit != 0)
+    { packed_.data()[controlBytePosition_] |= 1 << controlByteBitIndex_; }
+    ++controlByteBitIndex_;
+}
+
+void AdResourcePacker::writeByte(uint8_t byte)
+{ packed_.append(static_cast<char>(byte)); }
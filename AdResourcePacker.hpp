@@ -0,0 +1,72 @@
+#ifndef ADRESOURCEPACKER_HPP
+#define ADRESOURCEPACKER_HPP
+
+#include <QByteArray>
+#include <QVector>
+#include <cstdint>
+#include <vector>
+
+// Packs data into the LZ format read by AdResourceUnpacker. Matches are found
+// with hash chains over two byte prefixes, optionally with lazy matching.
+class AdResourcePacker
+{
+    static constexpr uint32_t MAX_SHORT_MATCH_OFFSET = 0x100;
+    static constexpr uint32_t MIN_SHORT_MATCH_LENGTH = 2;
+    static constexpr uint32_t MAX_SHORT_MATCH_LENGTH = 5;
+    static constexpr uint32_t MAX_LONG_MATCH_OFFSET = 0xfff;
+    static constexpr uint32_t MIN_LONG_MATCH_LENGTH = 3;
+    // Longer matches need additional length byte.
+    static constexpr uint32_t MAX_NIBBLE_MATCH_LENGTH = 0x11;
+    static constexpr uint32_t MAX_MATCH_LENGTH = 0x100;
+    static constexpr int32_t NO_POSITION = -1;
+
+    struct Match
+    {
+        uint32_t length;
+        uint32_t offset;
+    };
+
+public:
+    enum class Level
+    {
+        Fastest,
+        Balanced,
+        Smallest
+    };
+
+    AdResourcePacker(Level level = Level::Balanced);
+
+    QByteArray pack(QByteArray const& data);
+    QByteArray pack(uint8_t const* data, uint32_t size);
+    // Packs independent resources on threadsNumber threads (0 means one per
+    // hardware thread). Packed resources are returned in input order.
+    static QVector<QByteArray> packAll(
+            QVector<QByteArray> const& resources,
+            Level level = Level::Balanced,
+            unsigned threadsNumber = 0);
+
+private:
+    void resetInternalVariables(uint8_t const* data, uint32_t size);
+    void insertPositionsUpTo(uint32_t position);
+    Match findMatch(uint32_t position) const;
+    static bool isMatchUsable(Match const& match);
+    void writeLiteral(uint8_t byte);
+    void writeMatch(Match const& match);
+    void writeEndMarker();
+    void writeControlBit(uint8_t bit);
+    void writeByte(uint8_t byte);
+
+    uint32_t maxChainLength_;
+    uint32_t niceMatchLength_;
+    bool isLazy_;
+    uint8_t const* data_;
+    uint32_t size_;
+    uint32_t insertedPositionsNumber_;
+    std::vector<int32_t> chainHeads_;
+    std::vector<int32_t> previousPositions_;
+    QByteArray packed_;
+    int controlBytePosition_;
+    uint8_t controlByteBitIndex_;
+};
+
+#endif // ADRESOURCEPACKER_HPP
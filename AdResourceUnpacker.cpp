@@ -1,4 +1,108 @@
 #include "AdResourceUnpacker.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Number of literal flags (zero bits) before the first match flag, counting
+// from the least significant bit.
+struct LiteralsRunTable
+{
+    constexpr LiteralsRunTable()
+        : runs{}
+    {
+        for (uint32_t controlByte = 0; controlByte < 0x100; ++controlByte)
+        {
+            uint8_t run = 0;
+            while (run < BITS_IN_BYTE && (controlByte & (1 << run)) == 0)
+            { ++run; }
+            runs[controlByte] = run;
+        }
+    }
+
+    uint8_t runs[0x100];
+};
+
+static constexpr LiteralsRunTable LITERALS_RUN_TABLE;
+
+inline void broadcastPattern(uint8_t* dest, uint64_t pattern, uint16_t size)
+{
+    for (; size >= sizeof(pattern); size -= sizeof(pattern))
+    {
+        std::memcpy(dest, &pattern, sizeof(pattern));
+        dest += sizeof(pattern);
+    }
+    std::memcpy(dest, &pattern, size);
+}
+
+// Copies match of size bytes starting offset bytes back from dest. Source
+// and destination overlap when offset is smaller than size, in which case
+// the match repeats its first offset bytes.
+inline void copyMatch(uint8_t* dest, uint16_t offset, uint16_t size)
+{
+    uint8_t const* src = dest - offset;
+    if (offset >= size)
+    {
+        std::memcpy(dest, src, size);
+        return;
+    }
+    switch (offset)
+    {
+    case 0:
+        // Copying byte onto itself leaves output as it is.
+        return;
+    case 1:
+        std::memset(dest, *src, size);
+        return;
+    case 2:
+    {
+        uint16_t pattern;
+        std::memcpy(&pattern, src, sizeof(pattern));
+        broadcastPattern(dest, pattern * 0x0001000100010001ull, size);
+        return;
+    }
+    case 4:
+    {
+        uint32_t pattern;
+        std::memcpy(&pattern, src, sizeof(pattern));
+        broadcastPattern(dest, pattern * 0x0000000100000001ull, size);
+        return;
+    }
+    default:
+        break;
+    }
+    static constexpr uint16_t CHUNK_SIZE = 16;
+    if (offset >= CHUNK_SIZE)
+    {
+        for (; size >= CHUNK_SIZE; size -= CHUNK_SIZE)
+        {
+            std::memcpy(dest, src, CHUNK_SIZE);
+            dest += CHUNK_SIZE;
+            src += CHUNK_SIZE;
+        }
+        std::memcpy(dest, src, size);
+        return;
+    }
+    // Already written part of the match is periodic, so it can be copied
+    // as a whole, doubling copied span each time.
+    uint8_t const* periodStart = src;
+    while (size > 0)
+    {
+        uint16_t spanSize = static_cast<uint16_t>(dest - periodStart);
+        if (spanSize > size)
+        { spanSize = size; }
+        std::memcpy(dest, periodStart, spanSize);
+        dest += spanSize;
+        size -= spanSize;
+    }
+}
+
+} // namespace
+
+AdResourceUnpacker::AdResourceUnpacker()
+    : inBufferEnd_{inBuffer_}
+{}
 
 AdResourceUnpacker::AdResourceUnpacker(uint8_t const* buffer, uint32_t size)
     : inBuffer_{buffer},
@@ -9,102 +113,409 @@ AdResourceUnpacker::AdResourceUnpacker(uint8_t const* buffer, uint32_t size)
 void AdResourceUnpacker::setOutBufferSize(uint32_t outBufferSize)
 { outBufferSize_ = outBufferSize; }
 
-QByteArray AdResourceUnpacker::unpack()
+uint32_t AdResourceUnpacker::calculateUnpackedSize()
 {
-    resetInternalVariables();
+    resetInputVariables();
+    uint32_t unpackedSize = 0;
     while (true)
     {
-        while (!readControlBoolFlag())
-        { writeByte(readByte()); }
-
-        uint16_t bytesToDuplicateNumber;
-        uint16_t startDuplicationFromOffset;
-        if (readControlBoolFlag())
+        if (!readControlBoolFlag<true>())
         {
-            bytesToDuplicateNumber = readTwoControlBits() + 2;
-            startDuplicationFromOffset = readByte();
-            if (startDuplicationFromOffset == 0)
-            { startDuplicationFromOffset = 0x100; }
+            readByte<true>();
+            ++unpackedSize;
+            continue;
         }
-        else
+        uint16_t startDuplicationFromOffset;
+        uint16_t bytesToDuplicateNumber;
+        if (!readMatch<true>(
+                    startDuplicationFromOffset,
+                    bytesToDuplicateNumber))
+        { break; }
+        if (startDuplicationFromOffset > unpackedSize)
+        { throw QString("Trying to read beyond output buffer."); }
+        unpackedSize += bytesToDuplicateNumber;
+    }
+    return unpackedSize;
+}
+
+void AdResourceUnpacker::setDecoder(Decoder decoder)
+{ decoder_ = decoder; }
+
+QByteArray AdResourceUnpacker::unpack()
+{
+    if (outBufferSize_ == UNKNOWN_OUT_BUFFER_SIZE)
+    { outBufferSize_ = calculateUnpackedSize(); }
+    QByteArray outBuffer(outBufferSize_, Qt::Uninitialized);
+    auto unpackedSize = unpack({
+                reinterpret_cast<uint8_t*>(outBuffer.data()),
+                outBufferSize_,
+                outBufferSize_,
+                1 });
+    outBuffer.resize(unpackedSize);
+    return outBuffer;
+}
+
+uint32_t AdResourceUnpacker::unpack(AdUnpackTarget const& target)
+{
+    resetInputVariables();
+    resetOutputVariables(target);
+    if (decoder_ == Decoder::ControlByteTable)
+    {
+        if (!unpackFast<Decoder::ControlByteTable>())
+        { unpackChecked<Decoder::ControlByteTable>(); }
+    }
+    else
+    {
+        if (!unpackFast<Decoder::BitByBit>())
+        { unpackChecked<Decoder::BitByBit>(); }
+    }
+    return outTarget_.size() - outRemainingSize();
+}
+
+void AdResourceUnpacker::beginStream(AdUnpackTarget const& target)
+{
+    resetInputVariables();
+    resetOutputVariables(target);
+    streamCarrySize_ = 0;
+    isStreamEnded_ = false;
+}
+
+bool AdResourceUnpacker::feedStream(uint8_t const* data, uint32_t size)
+{
+    if (isStreamEnded_)
+    { return true; }
+    if (streamCarrySize_ > 0)
+    {
+        // Steps starting in carried over input are decoded from stream
+        // buffer, the rest directly from the chunk.
+        auto stagedSize = std::min<uint32_t>(
+                    size,
+                    STREAM_BUFFER_SIZE - streamCarrySize_);
+        std::memcpy(streamBuffer_.data() + streamCarrySize_, data, stagedSize);
+        auto const* carryEnd = streamBuffer_.data() + streamCarrySize_;
+        setInput(streamBuffer_.data(), streamCarrySize_ + stagedSize);
+        isStreamEnded_ = unpackStreamInput(carryEnd);
+        if (isStreamEnded_)
+        { return true; }
+        if (inPtr_ < carryEnd)
         {
-            uint16_t nextTwoBytes  = readTwoBytes();
-            if (nextTwoBytes == 0)
-            { break; }
-            bytesToDuplicateNumber = (nextTwoBytes & 0xf);
-            if (bytesToDuplicateNumber == 0)
-            { bytesToDuplicateNumber = readByte() + 1; }
-            else
-            { bytesToDuplicateNumber += 2; }
-            startDuplicationFromOffset = nextTwoBytes >> 4;
+            // Whole chunk was staged and it still does not hold a step.
+            streamCarrySize_ = static_cast<uint32_t>(inBufferEnd_ - inPtr_);
+            std::memmove(streamBuffer_.data(), inPtr_, streamCarrySize_);
+            return false;
         }
-        duplicateWrittenBytes(
-                    startDuplicationFromOffset,
-                    bytesToDuplicateNumber);
+        auto consumedSize = static_cast<uint32_t>(inPtr_ - carryEnd);
+        data += consumedSize;
+        size -= consumedSize;
+        streamCarrySize_ = 0;
+    }
+    setInput(data, size);
+    isStreamEnded_ = unpackStreamInput(inBufferEnd_);
+    if (!isStreamEnded_)
+    {
+        streamCarrySize_ = static_cast<uint32_t>(inBufferEnd_ - inPtr_);
+        std::memcpy(streamBuffer_.data(), inPtr_, streamCarrySize_);
+    }
+    return isStreamEnded_;
+}
+
+uint32_t AdResourceUnpacker::finishStream()
+{
+    if (!isStreamEnded_)
+    {
+        setInput(streamBuffer_.data(), streamCarrySize_);
+        streamCarrySize_ = 0;
+        if (decoder_ == Decoder::ControlByteTable)
+        { unpackChecked<Decoder::ControlByteTable>(); }
+        else
+        { unpackChecked<Decoder::BitByBit>(); }
+        isStreamEnded_ = true;
+    }
+    return outTarget_.size() - outRemainingSize();
+}
+
+void AdResourceUnpacker::resetInputVariables()
+{
+    controlBits_.clear();
+    setInput(inBuffer_, inBufferSize_);
+}
+
+void AdResourceUnpacker::setInput(uint8_t const* data, uint32_t size)
+{
+    inPtr_ = data;
+    inBufferEnd_ = data + size;
+}
+
+bool AdResourceUnpacker::unpackStreamInput(uint8_t const* stepsInEnd)
+{
+    if (decoder_ == Decoder::ControlByteTable)
+    { return unpackAvailable<Decoder::ControlByteTable>(stepsInEnd); }
+    else
+    { return unpackAvailable<Decoder::BitByBit>(stepsInEnd); }
+}
+
+void AdResourceUnpacker::resetOutputVariables(AdUnpackTarget const& target)
+{
+    outTarget_ = target;
+    outRowIndex_ = 0;
+    outPtr_ = outTarget_.row(0);
+    if (outTarget_.rowsNumber == 0)
+    {
+        outRowEnd_ = outPtr_;
+        outNextRowsSize_ = 0;
+    }
+    else
+    {
+        outRowEnd_ = outPtr_ + outTarget_.rowSize;
+        outNextRowsSize_ = outTarget_.size() - outTarget_.rowSize;
     }
-    resizeBufferToWrittenData();
-    return outBuffer_;
 }
 
-void AdResourceUnpacker::resetInternalVariables()
+void AdResourceUnpacker::advanceOutRow()
 {
-    controlByteBitIndex_ = BITS_IN_BYTE;
-    inPtr_ = inBuffer_;
-    outBuffer_.resize(outBufferSize_);
-    outPtr_ = reinterpret_cast<uint8_t*>(outBuffer_.data());
-    outBufferEnd_ = outPtr_ + outBuffer_.size();
+    ++outRowIndex_;
+    outPtr_ = outTarget_.row(outRowIndex_);
+    outRowEnd_ = outPtr_ + outTarget_.rowSize;
+    outNextRowsSize_ -= outTarget_.rowSize;
 }
 
+template<AdResourceUnpacker::Decoder decoder>
+bool AdResourceUnpacker::unpackFast()
+{
+    bool isControlByteStep = decoder == Decoder::ControlByteTable;
+    uint32_t minInSize = isControlByteStep ?
+                MAX_CONTROL_BYTE_STEP_IN_SIZE :
+                MAX_TOKEN_IN_SIZE;
+    uint32_t minOutSize = isControlByteStep ?
+                MAX_CONTROL_BYTE_STEP_OUT_SIZE :
+                MAX_TOKEN_OUT_SIZE;
+    while (
+            inBufferEnd_ - inPtr_ >= minInSize &&
+            outRemainingSize() >= minOutSize)
+    {
+        if (!unpackStep<decoder, false>())
+        { return true; }
+    }
+    return false;
+}
+
+template<AdResourceUnpacker::Decoder decoder>
+void AdResourceUnpacker::unpackChecked()
+{
+    while (unpackStep<decoder, true>())
+    {}
+}
+
+template<AdResourceUnpacker::Decoder decoder>
+bool AdResourceUnpacker::unpackAvailable(uint8_t const* stepsInEnd)
+{
+    bool isControlByteStep = decoder == Decoder::ControlByteTable;
+    uint32_t minInSize = isControlByteStep ?
+                MAX_CONTROL_BYTE_STEP_IN_SIZE :
+                MAX_TOKEN_IN_SIZE;
+    uint32_t minOutSize = isControlByteStep ?
+                MAX_CONTROL_BYTE_STEP_OUT_SIZE :
+                MAX_TOKEN_OUT_SIZE;
+    while (inPtr_ < stepsInEnd && inBufferEnd_ - inPtr_ >= minInSize)
+    {
+        // Input margin is guaranteed, only output needs checks near its end.
+        bool hasNextStep = outRemainingSize() >= minOutSize ?
+                    unpackStep<decoder, false>() :
+                    unpackStep<decoder, true>();
+        if (!hasNextStep)
+        { return true; }
+    }
+    return false;
+}
+
+template<AdResourceUnpacker::Decoder decoder, bool isChecked>
+bool AdResourceUnpacker::unpackStep()
+{
+    return decoder == Decoder::ControlByteTable ?
+                unpackControlByteStep<isChecked>() :
+                unpackToken<isChecked>();
+}
+
+template<bool isChecked>
+bool AdResourceUnpacker::unpackToken()
+{
+    if (!readControlBoolFlag<isChecked>())
+    {
+        writeByte<isChecked>(readByte<isChecked>());
+        return true;
+    }
+    return unpackMatch<isChecked>();
+}
+
+template<bool isChecked>
+bool AdResourceUnpacker::unpackControlByteStep()
+{
+    if (controlBits_.isEmpty())
+    { controlBits_.append(readByte<isChecked>(), BITS_IN_BYTE); }
+    uint8_t bitsLeft = controlBits_.size();
+    uint8_t literalsNumber =
+            LITERALS_RUN_TABLE.runs[controlBits_.peek(bitsLeft)];
+    if (literalsNumber >= bitsLeft)
+    {
+        copyLiterals<isChecked>(bitsLeft);
+        controlBits_.clear();
+        return true;
+    }
+    copyLiterals<isChecked>(literalsNumber);
+    // Skips literal flags together with the match flag.
+    controlBits_.consume(literalsNumber + 1);
+    return unpackMatch<isChecked>();
+}
+
+template<bool isChecked>
+bool AdResourceUnpacker::unpackMatch()
+{
+    uint16_t bytesToDuplicateNumber;
+    uint16_t startDuplicationFromOffset;
+    if (!readMatch<isChecked>(
+                startDuplicationFromOffset,
+                bytesToDuplicateNumber))
+    { return false; }
+    duplicateWrittenBytes<isChecked>(
+                startDuplicationFromOffset,
+                bytesToDuplicateNumber);
+    return true;
+}
+
+template<bool isChecked>
+bool AdResourceUnpacker::readMatch(
+        uint16_t& startDuplicationFromOffset,
+        uint16_t& bytesToDuplicateNumber)
+{
+    if (readControlBoolFlag<isChecked>())
+    {
+        bytesToDuplicateNumber = readTwoControlBits<isChecked>() + 2;
+        startDuplicationFromOffset = readByte<isChecked>();
+        if (startDuplicationFromOffset == 0)
+        { startDuplicationFromOffset = 0x100; }
+    }
+    else
+    {
+        uint16_t nextTwoBytes  = readTwoBytes<isChecked>();
+        if (nextTwoBytes == 0)
+        { return false; }
+        bytesToDuplicateNumber = (nextTwoBytes & 0xf);
+        if (bytesToDuplicateNumber == 0)
+        { bytesToDuplicateNumber = readByte<isChecked>() + 1; }
+        else
+        { bytesToDuplicateNumber += 2; }
+        startDuplicationFromOffset = nextTwoBytes >> 4;
+    }
+    return true;
+}
+
+template<bool isChecked>
+void AdResourceUnpacker::copyLiterals(uint8_t literalsNumber)
+{
+    if (isChecked)
+    {
+        if (inBufferEnd_ - inPtr_ < literalsNumber)
+        { throw QString("Trying to read beyond input buffer."); }
+        if (outRemainingSize() < literalsNumber)
+        { throw QString("Trying to write beyond output buffer."); }
+    }
+    while (literalsNumber > 0)
+    {
+        auto spanSize = static_cast<uint8_t>(std::min<uint32_t>(
+                    literalsNumber,
+                    outRowEnd_ - outPtr_));
+        std::memcpy(outPtr_, inPtr_, spanSize);
+        inPtr_ += spanSize;
+        outPtr_ += spanSize;
+        literalsNumber -= spanSize;
+        advanceOutRowIfFilled();
+    }
+}
+
+template<bool isChecked>
 void AdResourceUnpacker::duplicateWrittenBytes(
         uint16_t offset,
         uint16_t bytesNumber)
 {
-    auto const* src = outPtr_ - offset;
-    if (src < reinterpret_cast<decltype(src)>(outBuffer_.data()))
+    auto remainingSize = outRemainingSize();
+    auto writtenSize = outTarget_.size() - remainingSize;
+    // Offset comes from the stream, so it is checked on both paths.
+    if (offset > writtenSize)
     { throw QString("Trying to read beyond output buffer."); }
-    for (uint16_t i = 0; i < bytesNumber; ++i, ++src)
-    { writeByte(*src); }
-}
-
-void AdResourceUnpacker::resizeBufferToWrittenData()
-{
-    auto outBufferSize =
-            outPtr_ - reinterpret_cast<uint8_t const*>(outBuffer_.data());
-    outBuffer_.resize(outBufferSize);
+    if (isChecked && remainingSize < bytesNumber)
+    { throw QString("Trying to write beyond output buffer."); }
+    auto srcOffset = writtenSize - offset;
+    auto srcRowIndex = srcOffset / outTarget_.rowSize;
+    uint8_t const* src =
+            outTarget_.row(srcRowIndex) + srcOffset % outTarget_.rowSize;
+    uint8_t const* srcRowEnd =
+            outTarget_.row(srcRowIndex) + outTarget_.rowSize;
+    // Match is copied in spans which do not cross source or destination
+    // row end. Source and destination of a span can overlap only within
+    // the same row.
+    while (bytesNumber > 0)
+    {
+        auto spanSize = static_cast<uint16_t>(std::min<uint32_t>(
+                    std::min<uint32_t>(bytesNumber, outRowEnd_ - outPtr_),
+                    srcRowEnd - src));
+        if (srcRowIndex == outRowIndex_)
+        {
+            copyMatch(
+                        outPtr_,
+                        static_cast<uint16_t>(outPtr_ - src),
+                        spanSize);
+        }
+        else
+        { std::memcpy(outPtr_, src, spanSize); }
+        outPtr_ += spanSize;
+        src += spanSize;
+        bytesNumber -= spanSize;
+        advanceOutRowIfFilled();
+        if (src == srcRowEnd)
+        {
+            ++srcRowIndex;
+            src = outTarget_.row(srcRowIndex);
+            srcRowEnd = src + outTarget_.rowSize;
+        }
+    }
 }
 
+template<bool isChecked>
 uint8_t AdResourceUnpacker::readByte()
 {
-    if (inPtr_ >= inBufferEnd_)
+    if (isChecked && inPtr_ >= inBufferEnd_)
     { throw QString("Trying to read beyond input buffer."); }
     uint8_t nextByte = *inPtr_;
     ++inPtr_;
     return nextByte;
 }
 
+template<bool isChecked>
 uint16_t AdResourceUnpacker::readTwoBytes()
 {
-    uint16_t nextTwoBytes = readByte();
+    uint16_t nextTwoBytes = readByte<isChecked>();
     nextTwoBytes <<= 8;
-    nextTwoBytes |= readByte();
+    nextTwoBytes |= readByte<isChecked>();
     return nextTwoBytes;
 }
 
+template<bool isChecked>
 uint8_t AdResourceUnpacker::readControlBit()
 {
-    if (controlByteBitIndex_ >= BITS_IN_BYTE)
-    {
-        controlByte_ = readByte();
-        controlByteBitIndex_ = 0;
-    }
-    uint8_t controlBit = controlByte_ & 1;
-    controlByte_ >>= 1;
-    ++controlByteBitIndex_;
-    return controlBit;
+    // Control bytes are interleaved with data, so next one is read only
+    // when all bits of the previous one were used.
+    if (controlBits_.isEmpty())
+    { controlBits_.append(readByte<isChecked>(), BITS_IN_BYTE); }
+    return static_cast<uint8_t>(controlBits_.read(1));
 }
 
+template<bool isChecked>
 uint8_t AdResourceUnpacker::readTwoControlBits()
-{ return (readControlBit() << 1) | readControlBit(); }
+{
+    uint8_t highBit = readControlBit<isChecked>();
+    return (highBit << 1) | readControlBit<isChecked>();
+}
 
+template<bool isChecked>
 bool AdResourceUnpacker::readControlBoolFlag()
-{ return readControlBit() != 0; }
+{ return readControlBit<isChecked>() != 0; }
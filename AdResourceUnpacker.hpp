@@ -1,48 +1,160 @@
 #ifndef ADRESOURCEUNPACKER_HPP
 #define ADRESOURCEUNPACKER_HPP
 
-#include "BitsHelper.hpp"
+#include "BitsBuffer.hpp"
 #include <QByteArray>
 #include <QString>
+#include <array>
 #include <cstdint>
 
+// Destination of unpacked data made of equally sized rows placed rowStride
+// bytes apart, e.g. a rect in VRAM. Contiguous buffer is a single row.
+struct AdUnpackTarget
+{
+    uint8_t* data;
+    uint32_t rowSize;
+    uint32_t rowStride;
+    uint32_t rowsNumber;
+
+    uint32_t size() const
+    { return rowSize * rowsNumber; }
+    uint8_t* row(uint32_t rowIndex) const
+    { return data + rowIndex * rowStride; }
+};
+
 class AdResourceUnpacker
 {
-    static constexpr uint32_t DEFAULT_OUT_BUFFER_SIZE = 0x2000;
+    static constexpr uint32_t UNKNOWN_OUT_BUFFER_SIZE =
+            static_cast<uint32_t>(-1);
+    // Worst case token is a control byte followed by a long match (two bytes
+    // plus length byte).
+    static constexpr uint32_t MAX_TOKEN_IN_SIZE = 4;
+    // Long match length is stored in a byte and incremented by one.
+    static constexpr uint32_t MAX_TOKEN_OUT_SIZE = 0x100;
+    // Worst case control byte step is a control byte, 7 literals and a match
+    // whose flags cross into the next control byte.
+    static constexpr uint32_t MAX_CONTROL_BYTE_STEP_IN_SIZE =
+            1 + (BITS_IN_BYTE - 1) + MAX_TOKEN_IN_SIZE;
+    static constexpr uint32_t MAX_CONTROL_BYTE_STEP_OUT_SIZE =
+            (BITS_IN_BYTE - 1) + MAX_TOKEN_OUT_SIZE;
+    // Holds input carried over between stream chunks, which is shorter than
+    // a step, together with the beginning of the next chunk.
+    static constexpr uint32_t STREAM_BUFFER_SIZE =
+            2 * MAX_CONTROL_BYTE_STEP_IN_SIZE;
 
 public:
+    enum class Decoder
+    {
+        // Reference decoder, reads control flags one bit at a time.
+        BitByBit,
+        // Looks up literals run of the whole control byte in a table and
+        // copies the run at once.
+        ControlByteTable
+    };
+
+    // Creates unpacker in streaming mode, input is passed with feedStream().
+    AdResourceUnpacker();
     AdResourceUnpacker(uint8_t const* buffer, uint32_t size);
 
+    // When output buffer size is not set, unpack() calculates exact size
+    // with calculateUnpackedSize() first.
     void setOutBufferSize(uint32_t outBufferSize);
+    // Scans tokens without writing any output. Throws on corrupt stream.
+    uint32_t calculateUnpackedSize();
+    void setDecoder(Decoder decoder);
     QByteArray unpack();
+    // Back-references are resolved against target rows, so no intermediate
+    // buffer is needed. Returns number of unpacked bytes.
+    uint32_t unpack(AdUnpackTarget const& target);
+
+    // Streaming mode. Input can be fed in chunks of any size, e.g. sector by
+    // sector. Decoding suspends when a chunk does not hold a whole step and
+    // resumes with the next chunk. Returns true once end of stream is
+    // reached, further input is ignored then.
+    void beginStream(AdUnpackTarget const& target);
+    bool feedStream(uint8_t const* data, uint32_t size);
+    // Decodes carried over input. Throws if stream is not complete. Returns
+    // number of unpacked bytes.
+    uint32_t finishStream();
 
 private:
-    void resetInternalVariables();
+    void resetInputVariables();
+    void setInput(uint8_t const* data, uint32_t size);
+    bool unpackStreamInput(uint8_t const* stepsInEnd);
+    // Decodes steps starting before stepsInEnd for as long as input holds
+    // a worst case step. Returns true if end of stream was reached.
+    template<Decoder decoder>
+    bool unpackAvailable(uint8_t const* stepsInEnd);
+    void resetOutputVariables(AdUnpackTarget const& target);
+    inline uint32_t outRemainingSize() const
+    {
+        return outNextRowsSize_ +
+                static_cast<uint32_t>(outRowEnd_ - outPtr_);
+    }
+    inline void advanceOutRowIfFilled()
+    {
+        if (outPtr_ == outRowEnd_ && outNextRowsSize_ > 0)
+        { advanceOutRow(); }
+    }
+    void advanceOutRow();
+    // Decodes without bounds checks for as long as margins for worst case
+    // step remain. Returns true if end of stream was reached.
+    template<Decoder decoder>
+    bool unpackFast();
+    template<Decoder decoder>
+    void unpackChecked();
+    template<Decoder decoder, bool isChecked>
+    bool unpackStep();
+    template<bool isChecked>
+    bool unpackToken();
+    template<bool isChecked>
+    bool unpackControlByteStep();
+    template<bool isChecked>
+    bool unpackMatch();
+    template<bool isChecked>
+    bool readMatch(
+            uint16_t& startDuplicationFromOffset,
+            uint16_t& bytesToDuplicateNumber);
+    template<bool isChecked>
+    void copyLiterals(uint8_t literalsNumber);
+    template<bool isChecked>
     void duplicateWrittenBytes(uint16_t offset, uint16_t bytesNumber);
-    void resizeBufferToWrittenData();
+    template<bool isChecked>
     uint8_t readByte();
+    template<bool isChecked>
     uint16_t readTwoBytes();
+    template<bool isChecked>
     uint8_t readControlBit();
+    template<bool isChecked>
     uint8_t readTwoControlBits();
+    template<bool isChecked>
     bool readControlBoolFlag();
+    template<bool isChecked>
     inline void writeByte(uint8_t byte)
     {
-        if (outPtr_ >= outBufferEnd_)
+        if (isChecked && outRemainingSize() == 0)
         { throw QString("Trying to write beyond output buffer."); }
         *outPtr_ = byte;
         ++outPtr_;
+        advanceOutRowIfFilled();
     }
 
-    uint8_t const* inBuffer_;
-    uint32_t inBufferSize_;
+    uint8_t const* inBuffer_{nullptr};
+    uint32_t inBufferSize_{0};
     uint8_t const* inBufferEnd_;
-    uint32_t outBufferSize_{DEFAULT_OUT_BUFFER_SIZE};
+    uint32_t outBufferSize_{UNKNOWN_OUT_BUFFER_SIZE};
+    Decoder decoder_{Decoder::ControlByteTable};
     uint8_t const* inPtr_;
-    uint8_t controlByte_;
-    uint8_t controlByteBitIndex_;
-    QByteArray outBuffer_;
+    BitsBuffer<BitOrder::LsbFirst> controlBits_;
+    AdUnpackTarget outTarget_;
+    uint32_t outRowIndex_;
+    // Size of rows following the current one.
+    uint32_t outNextRowsSize_;
     uint8_t* outPtr_;
-    uint8_t const* outBufferEnd_;
+    uint8_t const* outRowEnd_;
+    std::array<uint8_t, STREAM_BUFFER_SIZE> streamBuffer_;
+    uint32_t streamCarrySize_{0};
+    bool isStreamEnded_{false};
 };
 
 #endif // ADRESOURCEUNPACKER_HPP
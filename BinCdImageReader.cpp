@@ -1,27 +1,94 @@
 #include "BinCdImageReader.hpp"
-#include <QFile>
+#include "CueSheet.hpp"
+#include "EcmImageDevice.hpp"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
 
 std::unique_ptr<BinCdImageReader> BinCdImageReader::create(
-        QString const& filePath)
+        QString const& filePath,
+        AccessMode accessMode)
 {
-    auto* binFile = new QFile(filePath);
+    auto fileSuffix = QFileInfo(filePath).suffix();
+    bool isCueSheet = fileSuffix.compare("cue", Qt::CaseInsensitive) == 0;
+    std::unique_ptr<CueTrack> dataTrack;
+    if (isCueSheet)
+    {
+        dataTrack = std::make_unique<CueTrack>(
+                    CueSheet::parse(filePath).firstDataTrack());
+    }
+    auto imageFilePath = dataTrack ? dataTrack->filePath : filePath;
+    QIODevice* binFile;
+    QFile* mappableFile = nullptr;
+    // ECM images are decoded on the fly, so they are always streamed.
+    if (EcmImageDevice::isEcmFile(imageFilePath))
+    { binFile = new EcmImageDevice(imageFilePath); }
+    else
+    {
+        mappableFile = new QFile(imageFilePath);
+        binFile = mappableFile;
+    }
     if (!binFile->open(QIODevice::ReadOnly))
     {
+        auto errorString = binFile->errorString();
+        delete binFile;
         throw QString("Could not open file %1. %2")
-                .arg(filePath)
-                .arg(binFile->errorString());
+                .arg(imageFilePath)
+                .arg(errorString);
+    }
+    std::unique_ptr<BinCdImageReader> binCdImageReader;
+    try
+    {
+        auto layout = dataTrack ?
+                    CdImageLayout::create(
+                        dataTrack->sectorMode,
+                        dataTrack->startFileOffset) :
+                    CdImageLayout::detect(*binFile);
+        qint64 imageDataEnd = binFile->size();
+        if (dataTrack && dataTrack->endFrame != CueTrack::UNTIL_FILE_END)
+        { imageDataEnd = std::min(imageDataEnd, dataTrack->endFileOffset); }
+        uchar const* mappedImage = nullptr;
+        // Mapping fails for sequential devices and some network mounts, in
+        // which case reader falls back to streamed access.
+        if (
+                accessMode == AccessMode::MemoryMapped &&
+                mappableFile != nullptr &&
+                !mappableFile->isSequential() &&
+                mappableFile->size() > 0)
+        { mappedImage = mappableFile->map(0, mappableFile->size()); }
+        binCdImageReader.reset(
+                    new BinCdImageReader(
+                        binFile,
+                        layout,
+                        imageDataEnd,
+                        mappedImage));
+    }
+    catch (...)
+    {
+        delete binFile;
+        throw;
     }
-    auto* binCdImageReader = new BinCdImageReader(binFile);
-    binFile->setParent(binCdImageReader);
-    return std::unique_ptr<BinCdImageReader>(binCdImageReader);
+    binFile->setParent(binCdImageReader.get());
+    binCdImageReader->loadFileIndex(imageFilePath);
+    return binCdImageReader;
 }
 
-BinCdImageReader::BinCdImageReader(QIODevice* binFile)
-    : binFile_{binFile}
-{
-    binFile_->seek(0);
-    binFileSize_ = binFile_->bytesAvailable();
-}
+BinCdImageReader::BinCdImageReader(
+        QIODevice* binFile,
+        CdImageLayout const& layout,
+        qint64 imageDataEnd,
+        uchar const* mappedImage)
+    : binFile_{binFile},
+      layout_(layout),
+      imageDataEnd_{imageDataEnd},
+      mappedImage_{mappedImage},
+      sectorCache_(mappedImage != nullptr ? 0 : SectorCache::DEFAULT_BUDGET)
+{}
+
+BinCdImageReader::~BinCdImageReader()
+{ prefetcher_.reset(); }
 
 uint32_t BinCdImageReader::calculateSectorsNumber(uint32_t dataSize)
 {
@@ -31,6 +98,67 @@ uint32_t BinCdImageReader::calculateSectorsNumber(uint32_t dataSize)
     return sectorsNumber;
 }
 
+CdImageLayout const& BinCdImageReader::layout() const
+{ return layout_; }
+
+Iso9660Index const& BinCdImageReader::fileIndex() const
+{ return fileIndex_; }
+
+QString const& BinCdImageReader::imageFingerprint() const
+{ return imageFingerprint_; }
+
+bool BinCdImageReader::isMemoryMapped() const
+{ return mappedImage_ != nullptr; }
+
+uint32_t BinCdImageReader::sectorsNumber() const
+{
+    auto trackDataSize = imageDataEnd_ - layout_.trackFileOffset;
+    return static_cast<uint32_t>(trackDataSize / layout_.sectorSize);
+}
+
+BinCdImageReader::SectorView BinCdImageReader::sectorView(uint32_t sector)
+{
+    if (isMemoryMapped())
+    {
+        assertSectorInImage(sector);
+        return { mappedSectorData(sector), DATA_IN_SECTOR_SIZE };
+    }
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    sectorViewBuffer_.resize(DATA_IN_SECTOR_SIZE);
+    readSectorsUnlocked(
+                sector,
+                1,
+                reinterpret_cast<uint8_t*>(sectorViewBuffer_.data()));
+    return {
+        reinterpret_cast<uint8_t const*>(sectorViewBuffer_.constData()),
+        DATA_IN_SECTOR_SIZE
+    };
+}
+
+bool BinCdImageReader::areSectorsViewedInPlace() const
+{ return isMemoryMapped() && layout_.isSectorsDataContiguous(); }
+
+BinCdImageReader::SectorsView BinCdImageReader::sectorsView(
+        uint32_t startSector,
+        uint32_t sectorsNumber)
+{
+    if (areSectorsViewedInPlace() && sectorsNumber > 0)
+    {
+        assertSectorInImage(startSector + sectorsNumber - 1);
+        return {
+            mappedSectorData(startSector),
+            sectorsNumber * DATA_IN_SECTOR_SIZE,
+            {}
+        };
+    }
+    SectorsView sectorsView;
+    sectorsView.buffer = readSectors(startSector, sectorsNumber);
+    sectorsView.data =
+            reinterpret_cast<uint8_t const*>(sectorsView.buffer.constData());
+    sectorsView.size = static_cast<uint32_t>(sectorsView.buffer.size());
+    return sectorsView;
+}
+
 QByteArray BinCdImageReader::readSector(uint32_t sector)
 { return readSectors(sector, 1); }
 
@@ -39,38 +167,351 @@ QByteArray BinCdImageReader::readSectors(
         uint32_t sectorsNumber)
 {
     QByteArray sectorData;
+    if (isMemoryMapped() || sectorCache_.budget() > 0 || sectorsNumber == 0)
+    {
+        sectorData.resize(DATA_IN_SECTOR_SIZE * sectorsNumber);
+        readSectors(
+                    startSector,
+                    sectorsNumber,
+                    reinterpret_cast<uint8_t*>(sectorData.data()));
+        return sectorData;
+    }
+    // Raw span is read straight into the result and sectors data is then
+    // compacted in place, so no intermediate buffer is needed.
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    sectorData.resize(layout_.rawSpanSize(sectorsNumber));
+    readRawSpan(startSector, sectorsNumber, sectorData.data());
+    layout_.deinterleaveSectorsData(
+                reinterpret_cast<uint8_t*>(sectorData.data()),
+                sectorsNumber);
     sectorData.resize(DATA_IN_SECTOR_SIZE * sectorsNumber);
-    char* sectorDataBuffer = sectorData.data();
+    return sectorData;
+}
+
+void BinCdImageReader::readSectors(
+        uint32_t startSector,
+        uint32_t sectorsNumber,
+        uint8_t* buffer)
+{
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    readSectorsUnlocked(startSector, sectorsNumber, buffer);
+}
+
+void BinCdImageReader::readSectorsUnlocked(
+        uint32_t startSector,
+        uint32_t sectorsNumber,
+        uint8_t* buffer)
+{
+    if (isMemoryMapped())
+    {
+        if (sectorsNumber == 0)
+        { return; }
+        assertSectorInImage(startSector + sectorsNumber - 1);
+        layout_.copySectorsData(
+                    mappedSectorData(startSector),
+                    sectorsNumber,
+                    buffer);
+        return;
+    }
+    if (sectorCache_.budget() == 0)
+    {
+        readUncachedSectors(startSector, sectorsNumber, buffer);
+        return;
+    }
+    // Consecutive sectors missing in the cache are read with a single span
+    // read and then put into the cache.
+    uint32_t const endSector = startSector + sectorsNumber;
+    uint32_t sector = startSector;
+    while (sector < endSector)
+    {
+        if (sectorCache_.fetch(sector, buffer, DATA_IN_SECTOR_SIZE))
+        {
+            ++sector;
+            buffer += DATA_IN_SECTOR_SIZE;
+            continue;
+        }
+        uint32_t missingEndSector = sector + 1;
+        while (
+               missingEndSector < endSector &&
+               !sectorCache_.contains(missingEndSector))
+        { ++missingEndSector; }
+        uint32_t missingSectorsNumber = missingEndSector - sector;
+        sectorCache_.recordMisses(missingSectorsNumber);
+        readUncachedSectors(sector, missingSectorsNumber, buffer);
+        for (; sector < missingEndSector; ++sector)
+        {
+            sectorCache_.insert(sector, buffer, DATA_IN_SECTOR_SIZE);
+            buffer += DATA_IN_SECTOR_SIZE;
+        }
+    }
+}
+
+void BinCdImageReader::setSectorCacheBudget(uint32_t budget)
+{
+    if (isMemoryMapped())
+    { return; }
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    sectorCache_.setBudget(budget);
+}
+
+SectorCache::Statistics BinCdImageReader::sectorCacheStatistics() const
+{
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    return sectorCache_.statistics();
+}
+
+SectorPrefetcher::PrefetchFuture BinCdImageReader::prefetchSectors(
+        uint32_t startSector,
+        uint32_t sectorsNumber)
+{
+    if (!prefetcher_)
+    {
+        prefetcher_ = std::make_unique<SectorPrefetcher>(
+                    [this](uint32_t startSector, uint32_t sectorsNumber) {
+            return loadSectorsIntoCache(startSector, sectorsNumber);
+        });
+    }
+    return prefetcher_->prefetch(startSector, sectorsNumber);
+}
+
+void BinCdImageReader::cancelPrefetches()
+{
+    if (prefetcher_)
+    { prefetcher_->cancel(); }
+}
+
+CdVerificationResult BinCdImageReader::verify(unsigned threadsNumber)
+{
+    CdSectorVerifier verifier(layout_.sectorMode);
+    CdVerificationResult result;
+    uint32_t const sectorsToVerifyNumber = sectorsNumber();
+    if (isMemoryMapped())
+    {
+        verifier.verify(
+                    mappedImage_ + layout_.trackFileOffset,
+                    0,
+                    sectorsToVerifyNumber,
+                    result,
+                    threadsNumber);
+        return result;
+    }
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    QByteArray rawSectors;
     for (
-         uint32_t sector = startSector;
-         sector < startSector + sectorsNumber;
-         ++sector)
+         uint32_t sector = 0;
+         sector < sectorsToVerifyNumber;
+         sector += VERIFIED_CHUNK_SECTORS_NUMBER)
     {
-        auto readBytes = readSector(sectorDataBuffer, sector);
-        sectorDataBuffer += readBytes;
+        uint32_t chunkSectorsNumber = sectorsToVerifyNumber - sector;
+        if (chunkSectorsNumber > VERIFIED_CHUNK_SECTORS_NUMBER)
+        { chunkSectorsNumber = VERIFIED_CHUNK_SECTORS_NUMBER; }
+        rawSectors.resize(chunkSectorsNumber * layout_.sectorSize);
+        readRawSectors(sector, chunkSectorsNumber, rawSectors.data());
+        verifier.verify(
+                    reinterpret_cast<uint8_t const*>(rawSectors.constData()),
+                    sector,
+                    chunkSectorsNumber,
+                    result,
+                    threadsNumber);
     }
-    return sectorData;
+    return result;
 }
 
-uint32_t BinCdImageReader::readSector(char* buffer, uint32_t sector)
+bool BinCdImageReader::loadSectorsIntoCache(
+        uint32_t startSector,
+        uint32_t sectorsNumber)
 {
-    setFilePositionToSector(sector);
-    auto readBytes = binFile_->read(buffer, DATA_IN_SECTOR_SIZE);
-    if (readBytes != DATA_IN_SECTOR_SIZE)
+    if (isMemoryMapped())
     {
-        throw QString(
-                    "Expected to read %1 bytes for sector 0x%2. Read %3 bytes.")
-                .arg(DATA_IN_SECTOR_SIZE)
+        pageInMappedSectors(startSector, sectorsNumber);
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    if (sectorCache_.budget() == 0)
+    { return false; }
+    uint32_t const endSector = startSector + sectorsNumber;
+    uint32_t sector = startSector;
+    while (sector < endSector)
+    {
+        if (sectorCache_.contains(sector))
+        {
+            ++sector;
+            continue;
+        }
+        uint32_t missingEndSector = sector + 1;
+        while (
+               missingEndSector < endSector &&
+               !sectorCache_.contains(missingEndSector))
+        { ++missingEndSector; }
+        uint32_t missingSectorsNumber = missingEndSector - sector;
+        prefetchBuffer_.resize(missingSectorsNumber * DATA_IN_SECTOR_SIZE);
+        auto* sectorData = reinterpret_cast<uint8_t*>(prefetchBuffer_.data());
+        readUncachedSectors(sector, missingSectorsNumber, sectorData);
+        for (; sector < missingEndSector; ++sector)
+        {
+            sectorCache_.insert(sector, sectorData, DATA_IN_SECTOR_SIZE);
+            sectorData += DATA_IN_SECTOR_SIZE;
+        }
+    }
+    return true;
+}
+
+void BinCdImageReader::pageInMappedSectors(
+        uint32_t startSector,
+        uint32_t sectorsNumber)
+{
+    static constexpr uint32_t PAGE_SIZE = 0x1000;
+    if (sectorsNumber == 0)
+    { return; }
+    uint32_t const lastSector = startSector + sectorsNumber - 1;
+    assertSectorInImage(lastSector);
+    auto const* data = mappedSectorData(startSector);
+    auto const* dataEnd = mappedSectorData(lastSector) + DATA_IN_SECTOR_SIZE;
+    uint8_t volatile touchedByte;
+    for (; data < dataEnd; data += PAGE_SIZE)
+    { touchedByte = *data; }
+    (void)touchedByte;
+}
+
+void BinCdImageReader::readUncachedSectors(
+        uint32_t startSector,
+        uint32_t sectorsNumber,
+        uint8_t* buffer)
+{
+    while (sectorsNumber > 0)
+    {
+        uint32_t chunkSectorsNumber =
+                sectorsNumber < MAX_COALESCED_SECTORS_NUMBER ?
+                    sectorsNumber :
+                    MAX_COALESCED_SECTORS_NUMBER;
+        rawSpanBuffer_.resize(layout_.rawSpanSize(chunkSectorsNumber));
+        readRawSpan(startSector, chunkSectorsNumber, rawSpanBuffer_.data());
+        layout_.copySectorsData(
+                    reinterpret_cast<uint8_t const*>(rawSpanBuffer_.data()),
+                    chunkSectorsNumber,
+                    buffer);
+        auto chunkDataSize = chunkSectorsNumber * DATA_IN_SECTOR_SIZE;
+        buffer += chunkDataSize;
+        startSector += chunkSectorsNumber;
+        sectorsNumber -= chunkSectorsNumber;
+    }
+}
+
+void BinCdImageReader::loadFileIndex(QString const& imageFilePath)
+{
+    static QString const INDEX_FILE_SUFFIX(".iso9660index");
+    auto indexFilePath = imageFilePath + INDEX_FILE_SUFFIX;
+    imageFingerprint_ = calculateImageFingerprint(imageFilePath);
+    if (Iso9660Index::load(indexFilePath, imageFingerprint_, fileIndex_))
+    { return; }
+    try
+    { fileIndex_ = Iso9660Index::build(*this); }
+    catch (QString const&)
+    {
+        fileIndex_ = Iso9660Index();
+        return;
+    }
+    try
+    { fileIndex_.save(indexFilePath, imageFingerprint_); }
+    catch (QString const&)
+    {
+        // Image directory may be read only. Index will be rebuilt on next
+        // open then.
+    }
+}
+
+QString BinCdImageReader::calculateImageFingerprint(
+        QString const& imageFilePath)
+{
+    // Size and modification time don't change when an image is replaced by
+    // a same sized one, e.g. restored from a backup, so system area and
+    // primary volume descriptor, which holds volume id and dates, are
+    // hashed too.
+    static constexpr uint32_t HASHED_SECTORS_NUMBER = 17;
+    QFileInfo imageFileInfo(imageFilePath);
+    auto hashedSectors = readSectors(
+                0,
+                std::min(sectorsNumber(), HASHED_SECTORS_NUMBER));
+    auto sectorsHash = QCryptographicHash::hash(
+                hashedSectors,
+                QCryptographicHash::Sha1);
+    return QString("%1:%2:%3:%4:%5")
+            .arg(imageFileInfo.size())
+            .arg(imageFileInfo.lastModified().toMSecsSinceEpoch())
+            .arg(layout_.trackFileOffset)
+            .arg(CdImageLayout::toQString(layout_.sectorMode))
+            .arg(QString::fromLatin1(sectorsHash.toHex()));
+}
+
+void BinCdImageReader::assertSectorInImage(uint32_t sector) const
+{
+    auto sectorDataEnd =
+            layout_.sectorDataFileOffset(sector) + DATA_IN_SECTOR_SIZE;
+    if (sectorDataEnd > imageDataEnd_)
+    {
+        throw QString("Sector 0x%1 is beyond image end (image size: 0x%2).")
                 .arg(sector, 0, 16)
+                .arg(imageDataEnd_, 0, 16);
+    }
+}
+
+uint8_t const* BinCdImageReader::mappedSectorData(uint32_t sector) const
+{
+    return mappedImage_ + layout_.sectorDataFileOffset(sector);
+}
+
+void BinCdImageReader::readRawSectors(
+        uint32_t startSector,
+        uint32_t sectorsNumber,
+        char* rawBuffer)
+{
+    auto fileOffset =
+            layout_.trackFileOffset +
+            static_cast<qint64>(startSector) * layout_.sectorSize;
+    if (!binFile_->seek(fileOffset))
+    {
+        throw QString("Could not set file position to 0x%1. %2")
+                .arg(fileOffset, 0, 16)
+                .arg(binFile_->errorString());
+    }
+    qint64 rawSectorsSize =
+            static_cast<qint64>(sectorsNumber) * layout_.sectorSize;
+    auto readBytes = binFile_->read(rawBuffer, rawSectorsSize);
+    if (readBytes != rawSectorsSize)
+    {
+        throw QString(
+                    "Expected to read %1 bytes for sectors 0x%2-0x%3. "
+                    "Read %4 bytes.")
+                .arg(rawSectorsSize)
+                .arg(startSector, 0, 16)
+                .arg(startSector + sectorsNumber - 1, 0, 16)
+                .arg(readBytes);
+    }
+}
+
+void BinCdImageReader::readRawSpan(
+        uint32_t startSector,
+        uint32_t sectorsNumber,
+        char* rawBuffer)
+{
+    setFilePositionToSector(startSector);
+    qint64 rawSpanSize = layout_.rawSpanSize(sectorsNumber);
+    auto readBytes = binFile_->read(rawBuffer, rawSpanSize);
+    if (readBytes != rawSpanSize)
+    {
+        throw QString(
+                    "Expected to read %1 bytes for sectors 0x%2-0x%3. "
+                    "Read %4 bytes.")
+                .arg(rawSpanSize)
+                .arg(startSector, 0, 16)
+                .arg(startSector + sectorsNumber - 1, 0, 16)
                 .arg(readBytes);
     }
-    return DATA_IN_SECTOR_SIZE;
 }
 
 void BinCdImageReader::setFilePositionToSector(uint32_t sector)
 {
-    auto fileOffset = calculateSectorFileOffset(sector);
-    fileOffset += DATA_IN_SECTOR_OFFSET;
+    auto fileOffset = layout_.sectorDataFileOffset(sector);
     if (!binFile_->seek(fileOffset))
     {
         throw QString("Could not set file position to 0x%1. %2")
@@ -78,6 +519,3 @@ void BinCdImageReader::setFilePositionToSector(uint32_t sector)
                 .arg(binFile_->errorString());
     }
 }
-
-int BinCdImageReader::calculateSectorFileOffset(uint32_t sector)
-{ return sector * SECTOR_SIZE; }
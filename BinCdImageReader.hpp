@@ -1,33 +1,140 @@
 #ifndef BINCDIMAGEREADER_HPP
 #define BINCDIMAGEREADER_HPP
 
+#include "CdImageLayout.hpp"
+#include "CdSectorVerifier.hpp"
+#include "Iso9660Index.hpp"
+#include "SectorCache.hpp"
+#include "SectorPrefetcher.hpp"
+#include <QFile>
 #include <QIODevice>
 #include <memory>
+#include <mutex>
 
 class BinCdImageReader : public QObject
 {
-    static constexpr uint32_t SECTOR_SIZE = 0x930;
-    static constexpr uint32_t DATA_IN_SECTOR_OFFSET = 0x18;
+    static constexpr uint32_t MAX_COALESCED_SECTORS_NUMBER = 0x100;
+    static constexpr uint32_t VERIFIED_CHUNK_SECTORS_NUMBER = 0x1000;
 
 public:
-    static constexpr uint32_t DATA_IN_SECTOR_SIZE = 0x800;
+    static constexpr uint32_t DATA_IN_SECTOR_SIZE =
+            CdImageLayout::DATA_IN_SECTOR_SIZE;
 
-    static std::unique_ptr<BinCdImageReader> create(QString const& filePath);
+    enum class AccessMode
+    {
+        Streamed,
+        MemoryMapped
+    };
+
+    // Non-owning view of a sector's data. For a memory mapped reader it
+    // points into the mapped image and stays valid for the reader's lifetime.
+    // Otherwise it points into an internal buffer which is overwritten by
+    // the next sectorView() call.
+    struct SectorView
+    {
+        uint8_t const* data;
+        uint32_t size;
+    };
+
+    // View of consecutive sectors' data. It points into the mapped image when
+    // the image is memory mapped and its sectors data is contiguous.
+    // Otherwise data is copied into buffer owned by the view.
+    struct SectorsView
+    {
+        uint8_t const* data;
+        uint32_t size;
+        QByteArray buffer;
+    };
+
+    // filePath is either a CUE sheet, in which case its first data track is
+    // read, or an image file whose layout is detected from its content.
+    // ECM compressed images (.ecm) are decoded on the fly and streamed.
+    static std::unique_ptr<BinCdImageReader> create(
+            QString const& filePath,
+            AccessMode accessMode = AccessMode::MemoryMapped);
+    ~BinCdImageReader();
 
     static uint32_t calculateSectorsNumber(uint32_t dataSize);
+    CdImageLayout const& layout() const;
+    // Index of the data track file system. It is built on open and persisted
+    // next to the image file, so later opens don't walk directories again.
+    // Empty if the track has no ISO9660 file system.
+    Iso9660Index const& fileIndex() const;
+    // Identifies image file version, for validating data cached next to it.
+    QString const& imageFingerprint() const;
+    bool isMemoryMapped() const;
+    uint32_t sectorsNumber() const;
+    SectorView sectorView(uint32_t sector);
+    // True if sectorsView() points into the mapped image instead of copying.
+    bool areSectorsViewedInPlace() const;
+    SectorsView sectorsView(uint32_t startSector, uint32_t sectorsNumber);
     QByteArray readSector(uint32_t sector);
     QByteArray readSectors(uint32_t startSector, uint32_t sectorsNumber);
+    void readSectors(
+            uint32_t startSector,
+            uint32_t sectorsNumber,
+            uint8_t* buffer);
+    // Sectors cache covers only streamed images, i.e. ECM ones or images
+    // opened with AccessMode::Streamed. Mapped image sectors are already in
+    // memory, so its cache is never allocated and budget stays 0. Budget 0
+    // disables the cache.
+    void setSectorCacheBudget(uint32_t budget);
+    SectorCache::Statistics sectorCacheStatistics() const;
+    // Announces sectors which will be read soon. They are loaded into the
+    // sector cache (or, for memory mapped image, paged in) by a background
+    // thread started on first call.
+    SectorPrefetcher::PrefetchFuture prefetchSectors(
+            uint32_t startSector,
+            uint32_t sectorsNumber);
+    void cancelPrefetches();
+    // Checks EDC/ECC of every sector of the data track. Throws when image
+    // layout has no EDC/ECC.
+    CdVerificationResult verify(unsigned threadsNumber = 0);
 
 private:
-    BinCdImageReader(QIODevice* binFile);
+    BinCdImageReader(
+            QIODevice* binFile,
+            CdImageLayout const& layout,
+            qint64 imageDataEnd,
+            uchar const* mappedImage = nullptr);
     BinCdImageReader(BinCdImageReader const&) = delete;
 
+    void loadFileIndex(QString const& imageFilePath);
+    QString calculateImageFingerprint(QString const& imageFilePath);
+    void assertSectorInImage(uint32_t sector) const;
+    uint8_t const* mappedSectorData(uint32_t sector) const;
     void setFilePositionToSector(uint32_t sector);
-    int calculateSectorFileOffset(uint32_t sector);
-    uint32_t readSector(char* buffer, uint32_t sector);
+    void readSectorsUnlocked(
+            uint32_t startSector,
+            uint32_t sectorsNumber,
+            uint8_t* buffer);
+    bool loadSectorsIntoCache(uint32_t startSector, uint32_t sectorsNumber);
+    void pageInMappedSectors(uint32_t startSector, uint32_t sectorsNumber);
+    void readUncachedSectors(
+            uint32_t startSector,
+            uint32_t sectorsNumber,
+            uint8_t* buffer);
+    void readRawSectors(
+            uint32_t startSector,
+            uint32_t sectorsNumber,
+            char* rawBuffer);
+    void readRawSpan(
+            uint32_t startSector,
+            uint32_t sectorsNumber,
+            char* rawBuffer);
 
     QIODevice* binFile_;
-    uint32_t binFileSize_;
+    CdImageLayout layout_;
+    qint64 imageDataEnd_;
+    Iso9660Index fileIndex_;
+    QString imageFingerprint_;
+    uchar const* mappedImage_;
+    QByteArray sectorViewBuffer_;
+    QByteArray rawSpanBuffer_;
+    SectorCache sectorCache_;
+    QByteArray prefetchBuffer_;
+    mutable std::mutex ioMutex_;
+    std::unique_ptr<SectorPrefetcher> prefetcher_;
 };
 
 #endif // BINCDIMAGEREADER_HPP
@@ -0,0 +1,95 @@
+#ifndef BITSBUFFER_HPP
+#define BITSBUFFER_HPP
+
+#include "BitsHelper.hpp"
+#include <cstdint>
+
+// Up to 64 bits queued in stream order. LsbFirst buffer keeps next bit in the
+// least significant bit, MsbFirst one in the most significant bit. Bits past
+// size() are always zero.
+template<BitOrder bitOrder>
+class BitsBuffer
+{
+public:
+    static constexpr uint8_t CAPACITY = 64;
+
+    uint8_t size() const
+    { return size_; }
+    uint8_t freeSize() const
+    { return CAPACITY - size_; }
+    bool isEmpty() const
+    { return size_ == 0; }
+
+    void clear()
+    {
+        bits_ = 0;
+        size_ = 0;
+    }
+
+    // value holds bitsNumber (1 to freeSize()) bits in its low bits, with
+    // first bit in stream order being the lowest one for LsbFirst and the
+    // highest one for MsbFirst. It can't have any other bits set.
+    void append(uint64_t value, uint8_t bitsNumber)
+    {
+        if (bitOrder == BitOrder::LsbFirst)
+        { bits_ |= value << (size_ & 63); }
+        else
+        { bits_ |= (value << (CAPACITY - bitsNumber)) >> (size_ & 63); }
+        size_ += bitsNumber;
+    }
+
+    // Appends as many whole bytes of word as fit. Word is in stream order,
+    // i.e. loaded as little endian for LsbFirst and big endian for MsbFirst.
+    // Returns number of appended bytes.
+    uint8_t appendBytes(uint64_t word)
+    {
+        uint8_t appendedBytes = freeSize() / BITS_IN_BYTE;
+        uint8_t appendedBits = appendedBytes * BITS_IN_BYTE;
+        uint64_t mask = ~0ull;
+        if (appendedBits < CAPACITY)
+        {
+            mask = bitOrder == BitOrder::LsbFirst ?
+                        (1ull << appendedBits) - 1 :
+                        ~(~0ull >> appendedBits);
+        }
+        if (bitOrder == BitOrder::LsbFirst)
+        { bits_ |= (word & mask) << (size_ & 63); }
+        else
+        { bits_ |= (word & mask) >> (size_ & 63); }
+        size_ += appendedBits;
+        return appendedBytes;
+    }
+
+    // bitsNumber has to be smaller than 64. Bits past size() are read as
+    // zeros.
+    uint64_t peek(uint8_t bitsNumber) const
+    {
+        if (bitOrder == BitOrder::LsbFirst)
+        { return bits_ & ((1ull << bitsNumber) - 1); }
+        else
+        { return (bits_ >> 1) >> (CAPACITY - 1 - bitsNumber); }
+    }
+
+    // bitsNumber has to be smaller than 64.
+    void consume(uint8_t bitsNumber)
+    {
+        if (bitOrder == BitOrder::LsbFirst)
+        { bits_ >>= bitsNumber; }
+        else
+        { bits_ <<= bitsNumber; }
+        size_ -= bitsNumber;
+    }
+
+    uint64_t read(uint8_t bitsNumber)
+    {
+        auto value = peek(bitsNumber);
+        consume(bitsNumber);
+        return value;
+    }
+
+private:
+    uint64_t bits_{0};
+    uint8_t size_{0};
+};
+
+#endif // BITSBUFFER_HPP
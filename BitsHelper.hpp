@@ -5,6 +5,14 @@
 
 static constexpr uint8_t BITS_IN_BYTE = 8;
 
+enum class BitOrder
+{
+    // Bits are taken from the least significant bit of each byte.
+    LsbFirst,
+    // Bits are taken from the most significant bit of each byte.
+    MsbFirst
+};
+
 inline constexpr uint32_t valuesInBits(uint8_t bits)
 { return 1 << bits; }
 
@@ -0,0 +1,139 @@
+#include "CdEdcEcc.hpp"
+#include <array>
+#include <cstring>
+
+namespace
+{
+
+static constexpr uint32_t EDC_POLYNOMIAL = 0xd8018001;
+static constexpr uint32_t EDC_SLICES_NUMBER = 8;
+
+// EDC is CRC32 computed with slicing-by-8, so 8 bytes are processed per
+// step with independent table lookups.
+struct EdcTables
+{
+    std::array<std::array<uint32_t, 0x100>, EDC_SLICES_NUMBER> slices;
+
+    EdcTables()
+    {
+        for (uint32_t i = 0; i < 0x100; ++i)
+        {
+            uint32_t edc = i;
+            for (int bit = 0; bit < 8; ++bit)
+            { edc = (edc >> 1) ^ ((edc & 1) ? EDC_POLYNOMIAL : 0); }
+            slices[0][i] = edc;
+        }
+        for (uint32_t i = 0; i < 0x100; ++i)
+        {
+            for (uint32_t slice = 1; slice < EDC_SLICES_NUMBER; ++slice)
+            {
+                auto previous = slices[slice - 1][i];
+                slices[slice][i] =
+                        (previous >> 8) ^ slices[0][previous & 0xff];
+            }
+        }
+    }
+};
+
+struct EccTables
+{
+    std::array<uint8_t, 0x100> f;
+    std::array<uint8_t, 0x100> b;
+
+    EccTables()
+    {
+        for (uint32_t i = 0; i < 0x100; ++i)
+        {
+            uint32_t j = (i << 1) ^ ((i & 0x80) ? 0x11d : 0);
+            f[i] = static_cast<uint8_t>(j);
+            b[i ^ j] = static_cast<uint8_t>(i);
+        }
+    }
+};
+
+EdcTables const& edcTables()
+{
+    static EdcTables const tables;
+    return tables;
+}
+
+EccTables const& eccTables()
+{
+    static EccTables const tables;
+    return tables;
+}
+
+// Calculates one of P/Q parity sets. Data starts at sector header.
+void calculateEccBlock(
+        uint8_t const* data,
+        uint32_t majorCount,
+        uint32_t minorCount,
+        uint32_t majorMultiplier,
+        uint32_t minorIncrement,
+        uint8_t* ecc)
+{
+    auto const& tables = eccTables();
+    uint32_t size = majorCount * minorCount;
+    for (uint32_t major = 0; major < majorCount; ++major)
+    {
+        uint32_t index = (major >> 1) * majorMultiplier + (major & 1);
+        uint8_t eccA = 0;
+        uint8_t eccB = 0;
+        for (uint32_t minor = 0; minor < minorCount; ++minor)
+        {
+            uint8_t value = data[index];
+            index += minorIncrement;
+            if (index >= size)
+            { index -= size; }
+            eccA ^= value;
+            eccB ^= value;
+            eccA = tables.f[eccA];
+        }
+        eccA = tables.b[tables.f[eccA] ^ eccB];
+        ecc[major] = eccA;
+        ecc[major + majorCount] = eccA ^ eccB;
+    }
+}
+
+} // namespace
+
+uint32_t CdEdcEcc::calculateEdc(uint8_t const* data, uint32_t size)
+{
+    auto const& t = edcTables().slices;
+    uint32_t edc = 0;
+    while (size >= EDC_SLICES_NUMBER)
+    {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, data, sizeof(low));
+        std::memcpy(&high, data + sizeof(low), sizeof(high));
+        low ^= edc;
+        edc = t[7][low & 0xff] ^
+                t[6][(low >> 8) & 0xff] ^
+                t[5][(low >> 16) & 0xff] ^
+                t[4][low >> 24] ^
+                t[3][high & 0xff] ^
+                t[2][(high >> 8) & 0xff] ^
+                t[1][(high >> 16) & 0xff] ^
+                t[0][high >> 24];
+        data += EDC_SLICES_NUMBER;
+        size -= EDC_SLICES_NUMBER;
+    }
+    for (; size > 0; --size, ++data)
+    { edc = (edc >> 8) ^ t[0][(edc ^ *data) & 0xff]; }
+    return edc;
+}
+
+void CdEdcEcc::calculateEccP(uint8_t const* sector, uint8_t* eccP)
+{ calculateEccBlock(sector + HEADER_OFFSET, ECC_P_SIZE / 2, 24, 2, 86, eccP); }
+
+void CdEdcEcc::calculateEccQ(uint8_t const* sector, uint8_t* eccQ)
+{
+    calculateEccBlock(sector + HEADER_OFFSET, ECC_Q_SIZE / 2, 43, 86, 88, eccQ);
+}
+
+void CdEdcEcc::generateEcc(uint8_t* sector)
+{
+    calculateEccP(sector, sector + ECC_P_OFFSET);
+    calculateEccQ(sector, sector + ECC_Q_OFFSET);
+}
@@ -0,0 +1,27 @@
+#ifndef CDEDCECC_HPP
+#define CDEDCECC_HPP
+
+#include <cstdint>
+
+// EDC and P/Q ECC of raw 2352 bytes sectors. ECC of Mode 2 sectors is
+// calculated with zeroed header.
+struct CdEdcEcc
+{
+    static constexpr uint32_t HEADER_OFFSET = 0xc;
+    static constexpr uint32_t HEADER_SIZE = 4;
+    static constexpr uint32_t ECC_P_OFFSET = 0x81c;
+    static constexpr uint32_t ECC_P_SIZE = 2 * 86;
+    static constexpr uint32_t ECC_Q_OFFSET = ECC_P_OFFSET + ECC_P_SIZE;
+    static constexpr uint32_t ECC_Q_SIZE = 2 * 52;
+
+    CdEdcEcc() = delete;
+
+    static uint32_t calculateEdc(uint8_t const* data, uint32_t size);
+    static void calculateEccP(uint8_t const* sector, uint8_t* eccP);
+    // Q parity covers also P parity, so P has to be in place.
+    static void calculateEccQ(uint8_t const* sector, uint8_t* eccQ);
+    // Writes P and Q parity into sector.
+    static void generateEcc(uint8_t* sector);
+};
+
+#endif // CDEDCECC_HPP
@@ -0,0 +1,159 @@
+#include "CdImageLayout.hpp"
+#include <cstring>
+
+namespace
+{
+
+static constexpr uint8_t SECTOR_SYNC[] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00
+};
+static constexpr uint32_t SECTOR_MODE_OFFSET = 0xf;
+// Volume descriptors start at sector 16 and begin with type and
+// "CD001" identifier.
+static constexpr uint32_t VOLUME_DESCRIPTOR_SECTOR = 16;
+static constexpr char VOLUME_DESCRIPTOR_ID[] = "CD001";
+
+template <uint32_t SECTOR_SIZE>
+void copySectorsData(
+        uint8_t const* rawSpan,
+        uint32_t sectorsNumber,
+        uint8_t* buffer)
+{
+    for (uint32_t sector = 0; sector < sectorsNumber; ++sector)
+    {
+        std::memcpy(buffer, rawSpan, CdImageLayout::DATA_IN_SECTOR_SIZE);
+        rawSpan += SECTOR_SIZE;
+        buffer += CdImageLayout::DATA_IN_SECTOR_SIZE;
+    }
+}
+
+template <>
+void copySectorsData<CdImageLayout::DATA_IN_SECTOR_SIZE>(
+        uint8_t const* rawSpan,
+        uint32_t sectorsNumber,
+        uint8_t* buffer)
+{
+    std::memcpy(
+                buffer,
+                rawSpan,
+                sectorsNumber * CdImageLayout::DATA_IN_SECTOR_SIZE);
+}
+
+template <uint32_t SECTOR_SIZE>
+void deinterleaveSectorsData(uint8_t* rawSpan, uint32_t sectorsNumber)
+{
+    // First sector data is already in place. Every next sector data is moved
+    // towards span start, so it never overwrites data not moved yet.
+    for (uint32_t sector = 1; sector < sectorsNumber; ++sector)
+    {
+        std::memmove(
+                    rawSpan + sector * CdImageLayout::DATA_IN_SECTOR_SIZE,
+                    rawSpan + sector * SECTOR_SIZE,
+                    CdImageLayout::DATA_IN_SECTOR_SIZE);
+    }
+}
+
+template <>
+void deinterleaveSectorsData<CdImageLayout::DATA_IN_SECTOR_SIZE>(
+        uint8_t*,
+        uint32_t)
+{}
+
+template <uint32_t SECTOR_SIZE>
+CdImageLayout createLayout(
+        CdSectorMode sectorMode,
+        uint32_t dataInSectorOffset,
+        qint64 trackFileOffset)
+{
+    return {
+        sectorMode,
+        SECTOR_SIZE,
+        dataInSectorOffset,
+        trackFileOffset,
+        &copySectorsData<SECTOR_SIZE>,
+        &deinterleaveSectorsData<SECTOR_SIZE>
+    };
+}
+
+bool hasVolumeDescriptor(QIODevice& imageFile, CdImageLayout const& layout)
+{
+    char identifier[sizeof(VOLUME_DESCRIPTOR_ID) - 1];
+    if (!imageFile.seek(
+                layout.sectorDataFileOffset(VOLUME_DESCRIPTOR_SECTOR) + 1))
+    { return false; }
+    if (imageFile.read(identifier, sizeof(identifier)) != sizeof(identifier))
+    { return false; }
+    return std::memcmp(
+                identifier,
+                VOLUME_DESCRIPTOR_ID,
+                sizeof(identifier)) == 0;
+}
+
+} // namespace
+
+CdImageLayout CdImageLayout::create(
+        CdSectorMode sectorMode,
+        qint64 trackFileOffset)
+{
+    switch (sectorMode)
+    {
+    case CdSectorMode::Mode1:
+        return createLayout<0x930>(sectorMode, 0x10, trackFileOffset);
+    case CdSectorMode::Mode2:
+        return createLayout<0x930>(sectorMode, 0x18, trackFileOffset);
+    case CdSectorMode::Mode2NoSync:
+        return createLayout<0x920>(sectorMode, 0x8, trackFileOffset);
+    case CdSectorMode::Plain2048:
+        return createLayout<0x800>(sectorMode, 0x0, trackFileOffset);
+    default:
+        throw QString("Unknown sector mode %1.")
+                .arg(static_cast<int>(sectorMode));
+    }
+}
+
+CdImageLayout CdImageLayout::detect(QIODevice& imageFile)
+{
+    uint8_t sectorHeader[sizeof(SECTOR_SYNC) + 4];
+    if (!imageFile.seek(0))
+    { throw QString("Could not detect image layout. Seek failed."); }
+    auto readBytes = imageFile.read(
+                reinterpret_cast<char*>(sectorHeader),
+                sizeof(sectorHeader));
+    if (
+            readBytes == sizeof(sectorHeader) &&
+            std::memcmp(sectorHeader, SECTOR_SYNC, sizeof(SECTOR_SYNC)) == 0)
+    {
+        auto mode = sectorHeader[SECTOR_MODE_OFFSET];
+        if (mode == 1)
+        { return create(CdSectorMode::Mode1); }
+        if (mode == 2)
+        { return create(CdSectorMode::Mode2); }
+        throw QString("Unsupported raw sector mode %1.").arg(mode);
+    }
+    for (
+         auto sectorMode :
+         {CdSectorMode::Plain2048, CdSectorMode::Mode2NoSync})
+    {
+        auto layout = create(sectorMode);
+        if (hasVolumeDescriptor(imageFile, layout))
+        { return layout; }
+    }
+    throw QString("Could not detect image layout.");
+}
+
+QString CdImageLayout::toQString(CdSectorMode sectorMode)
+{
+    switch (sectorMode)
+    {
+    case CdSectorMode::Mode1:
+        return "MODE1/2352";
+    case CdSectorMode::Mode2:
+        return "MODE2/2352";
+    case CdSectorMode::Mode2NoSync:
+        return "MODE2/2336";
+    case CdSectorMode::Plain2048:
+        return "MODE1/2048";
+    default:
+        return QString("Unknown (%1)").arg(static_cast<int>(sectorMode));
+    }
+}
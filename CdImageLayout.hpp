@@ -0,0 +1,65 @@
+#ifndef CDIMAGELAYOUT_HPP
+#define CDIMAGELAYOUT_HPP
+
+#include <QIODevice>
+#include <QString>
+#include <cstdint>
+
+// Mode 2 tracks mix Form 1 and Form 2 sectors in the same raw sector layout.
+// Only Form 1 payload (0x800 bytes at 0x18) is read, Form 2 sectors (0x914
+// bytes payload) are not supported.
+enum class CdSectorMode
+{
+    Mode1,
+    Mode2,
+    Mode2NoSync,
+    Plain2048
+};
+
+// Describes how sectors data is stored in an image file. Sectors data is
+// copied with a kernel specialized for the sector stride, picked when the
+// layout is created.
+struct CdImageLayout
+{
+    static constexpr uint32_t DATA_IN_SECTOR_SIZE = 0x800;
+
+    // Copies data of consecutive sectors. rawSpan points at first sector's
+    // data.
+    using SectorsDataCopier = void (*)(
+            uint8_t const* rawSpan,
+            uint32_t sectorsNumber,
+            uint8_t* buffer);
+    // Compacts data of consecutive sectors in place. rawSpan points at
+    // first sector's data.
+    using SectorsDataDeinterleaver = void (*)(
+            uint8_t* rawSpan,
+            uint32_t sectorsNumber);
+
+    CdSectorMode sectorMode;
+    uint32_t sectorSize;
+    uint32_t dataInSectorOffset;
+    qint64 trackFileOffset;
+    SectorsDataCopier copySectorsData;
+    SectorsDataDeinterleaver deinterleaveSectorsData;
+
+    static CdImageLayout create(
+            CdSectorMode sectorMode,
+            qint64 trackFileOffset = 0);
+    static CdImageLayout detect(QIODevice& imageFile);
+    static QString toQString(CdSectorMode sectorMode);
+
+    qint64 sectorDataFileOffset(uint32_t sector) const
+    {
+        return trackFileOffset +
+                static_cast<qint64>(sector) * sectorSize +
+                dataInSectorOffset;
+    }
+    uint32_t rawSpanSize(uint32_t sectorsNumber) const
+    { return (sectorsNumber - 1) * sectorSize + DATA_IN_SECTOR_SIZE; }
+    // Sectors hold data only, so data of consecutive sectors follows each
+    // other without gaps.
+    bool isSectorsDataContiguous() const
+    { return sectorSize == DATA_IN_SECTOR_SIZE; }
+};
+
+#endif // CDIMAGELAYOUT_HPP
@@ -0,0 +1,152 @@
+#include "CdSectorVerifier.hpp"
+#include "CdEdcEcc.hpp"
+#include <QString>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+static constexpr uint32_t SUBHEADER_OFFSET = 0x10;
+static constexpr uint8_t SUBMODE_FORM2_FLAG = 0x20;
+static constexpr uint32_t MODE1_EDC_OFFSET = 0x810;
+static constexpr uint32_t MODE2_FORM1_EDC_OFFSET = 0x818;
+static constexpr uint32_t MODE2_FORM2_EDC_OFFSET = 0x92c;
+
+bool isEdcValid(uint8_t const* rawSector, uint32_t start, uint32_t edcOffset)
+{
+    uint32_t storedEdc;
+    std::memcpy(&storedEdc, rawSector + edcOffset, sizeof(storedEdc));
+    return CdEdcEcc::calculateEdc(rawSector + start, edcOffset - start) ==
+            storedEdc;
+}
+
+} // namespace
+
+bool CdSectorVerifier::isSupported(CdSectorMode sectorMode)
+{
+    return sectorMode == CdSectorMode::Mode1 ||
+            sectorMode == CdSectorMode::Mode2;
+}
+
+CdSectorVerifier::CdSectorVerifier(CdSectorMode sectorMode)
+    : sectorMode_{sectorMode}
+{
+    if (!isSupported(sectorMode))
+    {
+        throw QString("Sectors in %1 mode can't be verified.")
+                .arg(CdImageLayout::toQString(sectorMode));
+    }
+}
+
+void CdSectorVerifier::verify(
+        uint8_t const* rawSectors,
+        uint32_t firstSector,
+        uint32_t sectorsNumber,
+        CdVerificationResult& result,
+        unsigned threadsNumber) const
+{
+    if (threadsNumber == 0)
+    { threadsNumber = std::max(1u, std::thread::hardware_concurrency()); }
+    if (threadsNumber > sectorsNumber)
+    { threadsNumber = std::max(1u, sectorsNumber); }
+    std::vector<CdVerificationResult> threadsResults(threadsNumber);
+    std::vector<std::thread> threads;
+    uint32_t sectorsPerThread = sectorsNumber / threadsNumber;
+    uint32_t sector = 0;
+    for (unsigned thread = 0; thread < threadsNumber; ++thread)
+    {
+        uint32_t threadSectorsNumber =
+                thread + 1 < threadsNumber ?
+                    sectorsPerThread :
+                    sectorsNumber - sector;
+        auto* threadResult = &threadsResults[thread];
+        auto const* threadRawSectors = rawSectors + sector * RAW_SECTOR_SIZE;
+        auto threadFirstSector = firstSector + sector;
+        threads.emplace_back([=]() {
+            verifyRange(
+                        threadRawSectors,
+                        threadFirstSector,
+                        threadSectorsNumber,
+                        *threadResult);
+        });
+        sector += threadSectorsNumber;
+    }
+    for (auto& thread : threads)
+    { thread.join(); }
+    for (auto const& threadResult : threadsResults)
+    {
+        result.checkedSectorsNumber += threadResult.checkedSectorsNumber;
+        for (auto badSector : threadResult.badEdcSectors)
+        { result.badEdcSectors.append(badSector); }
+        for (auto badSector : threadResult.badEccSectors)
+        { result.badEccSectors.append(badSector); }
+    }
+}
+
+bool CdSectorVerifier::verifyEdc(uint8_t const* rawSector) const
+{
+    if (sectorMode_ == CdSectorMode::Mode1)
+    { return isEdcValid(rawSector, 0, MODE1_EDC_OFFSET); }
+    auto submode = rawSector[SUBHEADER_OFFSET + 2];
+    if ((submode & SUBMODE_FORM2_FLAG) == 0)
+    { return isEdcValid(rawSector, SUBHEADER_OFFSET, MODE2_FORM1_EDC_OFFSET); }
+    uint32_t storedEdc;
+    std::memcpy(
+                &storedEdc,
+                rawSector + MODE2_FORM2_EDC_OFFSET,
+                sizeof(storedEdc));
+    return storedEdc == 0 ||
+            isEdcValid(rawSector, SUBHEADER_OFFSET, MODE2_FORM2_EDC_OFFSET);
+}
+
+bool CdSectorVerifier::verifyEcc(uint8_t const* rawSector) const
+{
+    uint8_t const* eccData = rawSector;
+    std::array<uint8_t, RAW_SECTOR_SIZE> mode2Sector;
+    if (sectorMode_ == CdSectorMode::Mode2)
+    {
+        auto submode = rawSector[SUBHEADER_OFFSET + 2];
+        if ((submode & SUBMODE_FORM2_FLAG) != 0)
+        { return true; }
+        std::memcpy(mode2Sector.data(), rawSector, RAW_SECTOR_SIZE);
+        std::memset(
+                    mode2Sector.data() + CdEdcEcc::HEADER_OFFSET,
+                    0,
+                    CdEdcEcc::HEADER_SIZE);
+        eccData = mode2Sector.data();
+    }
+    std::array<uint8_t, CdEdcEcc::ECC_P_SIZE> eccP;
+    CdEdcEcc::calculateEccP(eccData, eccP.data());
+    if (std::memcmp(
+                eccP.data(),
+                rawSector + CdEdcEcc::ECC_P_OFFSET,
+                eccP.size()) != 0)
+    { return false; }
+    std::array<uint8_t, CdEdcEcc::ECC_Q_SIZE> eccQ;
+    CdEdcEcc::calculateEccQ(eccData, eccQ.data());
+    return std::memcmp(
+                eccQ.data(),
+                rawSector + CdEdcEcc::ECC_Q_OFFSET,
+                eccQ.size()) == 0;
+}
+
+void CdSectorVerifier::verifyRange(
+        uint8_t const* rawSectors,
+        uint32_t firstSector,
+        uint32_t sectorsNumber,
+        CdVerificationResult& result) const
+{
+    for (uint32_t index = 0; index < sectorsNumber; ++index)
+    {
+        auto const* rawSector = rawSectors + index * RAW_SECTOR_SIZE;
+        if (!verifyEdc(rawSector))
+        { result.badEdcSectors.append(firstSector + index); }
+        if (!verifyEcc(rawSector))
+        { result.badEccSectors.append(firstSector + index); }
+        ++result.checkedSectorsNumber;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef CDSECTORVERIFIER_HPP
+#define CDSECTORVERIFIER_HPP
+
+#include "CdImageLayout.hpp"
+#include <QVector>
+#include <cstdint>
+
+struct CdVerificationResult
+{
+    uint32_t checkedSectorsNumber{0};
+    QVector<uint32_t> badEdcSectors;
+    QVector<uint32_t> badEccSectors;
+
+    bool isValid() const
+    { return badEdcSectors.isEmpty() && badEccSectors.isEmpty(); }
+};
+
+// Checks EDC and P/Q ECC of raw (2352 bytes) Mode 1 and Mode 2 sectors.
+// Mode 2 Form 2 sectors have no ECC and their EDC is optional, so it is only
+// checked when present.
+class CdSectorVerifier
+{
+public:
+    static constexpr uint32_t RAW_SECTOR_SIZE = 0x930;
+
+    static bool isSupported(CdSectorMode sectorMode);
+
+    CdSectorVerifier(CdSectorMode sectorMode);
+
+    // Verifies sectorsNumber consecutive raw sectors, splitting them between
+    // threadsNumber threads (0 means one per hardware thread). Bad sectors are
+    // appended to result in ascending order.
+    void verify(
+            uint8_t const* rawSectors,
+            uint32_t firstSector,
+            uint32_t sectorsNumber,
+            CdVerificationResult& result,
+            unsigned threadsNumber = 0) const;
+    bool verifyEdc(uint8_t const* rawSector) const;
+    bool verifyEcc(uint8_t const* rawSector) const;
+
+private:
+    void verifyRange(
+            uint8_t const* rawSectors,
+            uint32_t firstSector,
+            uint32_t sectorsNumber,
+            CdVerificationResult& result) const;
+
+    CdSectorMode sectorMode_;
+};
+
+#endif // CDSECTORVERIFIER_HPP
@@ -0,0 +1,198 @@
+#include "CueSheet.hpp"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+
+namespace
+{
+
+static constexpr uint32_t AUDIO_SECTOR_SIZE = 0x930;
+static constexpr uint32_t FRAMES_PER_SECOND = 75;
+static constexpr uint32_t SECONDS_PER_MINUTE = 60;
+static constexpr uint32_t NO_PREGAP = static_cast<uint32_t>(-1);
+
+QStringList splitTokens(QString const& line)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return line.split(' ', Qt::SkipEmptyParts);
+#else
+    return line.split(' ', QString::SkipEmptyParts);
+#endif
+}
+
+} // namespace
+
+CueSheet CueSheet::parse(QString const& cueFilePath)
+{
+    QFile cueFile(cueFilePath);
+    if (!cueFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        throw QString("Could not open file %1. %2")
+                .arg(cueFilePath)
+                .arg(cueFile.errorString());
+    }
+    CueSheet cueSheet;
+    auto cueDirectory = QFileInfo(cueFilePath).absolutePath();
+    QTextStream cueStream(&cueFile);
+    while (!cueStream.atEnd())
+    { cueSheet.parseLine(cueStream.readLine().trimmed(), cueDirectory); }
+    if (cueSheet.tracks_.isEmpty())
+    { throw QString("No tracks in CUE sheet %1.").arg(cueFilePath); }
+    cueSheet.calculateTracksBounds();
+    return cueSheet;
+}
+
+QVector<CueTrack> const& CueSheet::tracks() const
+{ return tracks_; }
+
+CueTrack const& CueSheet::firstDataTrack() const
+{
+    for (auto const& track : tracks_)
+    {
+        if (track.isData)
+        { return track; }
+    }
+    throw QString("No data track in CUE sheet.");
+}
+
+void CueSheet::parseLine(QString const& line, QString const& cueDirectory)
+{
+    auto tokens = splitTokens(line);
+    if (tokens.isEmpty())
+    { return; }
+    auto const& command = tokens.first();
+    if (command == "FILE")
+    { parseFileLine(line, cueDirectory); }
+    else if (command == "TRACK")
+    { parseTrackLine(tokens); }
+    else if (command == "INDEX")
+    { parseIndexLine(tokens); }
+}
+
+void CueSheet::parseFileLine(QString const& line, QString const& cueDirectory)
+{
+    // File name may contain spaces, so it is taken from between the quotes.
+    int nameStart = line.indexOf('"');
+    int nameEnd = line.lastIndexOf('"');
+    QString fileName;
+    if (nameStart >= 0 && nameEnd > nameStart)
+    { fileName = line.mid(nameStart + 1, nameEnd - nameStart - 1); }
+    else
+    {
+        auto tokens = splitTokens(line);
+        if (tokens.size() < 2)
+        { throwParseError(line); }
+        fileName = tokens[1];
+    }
+    currentFilePath_ = QDir(cueDirectory).filePath(fileName);
+}
+
+void CueSheet::parseTrackLine(QStringList const& tokens)
+{
+    if (tokens.size() < 3 || currentFilePath_.isEmpty())
+    { throwParseError(tokens.join(' ')); }
+    CueTrack track;
+    track.number = tokens[1].toUInt();
+    track.filePath = currentFilePath_;
+    auto const& type = tokens[2].toUpper();
+    track.isData = true;
+    if (type == "AUDIO")
+    {
+        track.isData = false;
+        track.sectorMode = CdSectorMode::Mode2;
+        track.sectorSize = AUDIO_SECTOR_SIZE;
+    }
+    else if (type == "MODE1/2352")
+    { track.sectorMode = CdSectorMode::Mode1; }
+    else if (type == "MODE2/2352")
+    { track.sectorMode = CdSectorMode::Mode2; }
+    else if (type == "MODE2/2336")
+    { track.sectorMode = CdSectorMode::Mode2NoSync; }
+    else if (type == "MODE1/2048")
+    { track.sectorMode = CdSectorMode::Plain2048; }
+    else
+    { throw QString("Unsupported CUE track type %1.").arg(type); }
+    if (track.isData)
+    { track.sectorSize = CdImageLayout::create(track.sectorMode).sectorSize; }
+    track.startFrame = 0;
+    track.endFrame = CueTrack::UNTIL_FILE_END;
+    track.startFileOffset = 0;
+    track.endFileOffset = 0;
+    tracks_.append(track);
+    pregapStartFrames_.append(NO_PREGAP);
+}
+
+void CueSheet::parseIndexLine(QStringList const& tokens)
+{
+    if (tokens.size() < 3 || tracks_.isEmpty())
+    { throwParseError(tokens.join(' ')); }
+    auto indexNumber = tokens[1].toUInt();
+    auto frame = parseMsf(tokens[2]);
+    if (indexNumber == 0)
+    { pregapStartFrames_.last() = frame; }
+    else if (indexNumber == 1)
+    { tracks_.last().startFrame = frame; }
+}
+
+void CueSheet::calculateTracksBounds()
+{
+    // Track ends where next track in the same file starts (including its
+    // pregap). Frames between the end of previous track and the start of
+    // a track have the track's sector size.
+    uint32_t trackAreaStartFrame = 0;
+    qint64 trackAreaStartFileOffset = 0;
+    for (int index = 0; index < tracks_.size(); ++index)
+    {
+        auto& track = tracks_[index];
+        if (index > 0 && tracks_[index - 1].filePath != track.filePath)
+        {
+            trackAreaStartFrame = 0;
+            trackAreaStartFileOffset = 0;
+        }
+        auto calculateFileOffset = [&](uint32_t frame) {
+            if (frame < trackAreaStartFrame)
+            {
+                throw QString("CUE track %1 overlaps previous track.")
+                        .arg(track.number);
+            }
+            return trackAreaStartFileOffset +
+                    static_cast<qint64>(frame - trackAreaStartFrame) *
+                    track.sectorSize;
+        };
+        track.startFileOffset = calculateFileOffset(track.startFrame);
+        bool isLastTrackInFile =
+                index + 1 == tracks_.size() ||
+                tracks_[index + 1].filePath != track.filePath;
+        if (isLastTrackInFile)
+        { continue; }
+        auto nextTrackPregapStartFrame = pregapStartFrames_[index + 1];
+        track.endFrame = nextTrackPregapStartFrame != NO_PREGAP ?
+                    nextTrackPregapStartFrame :
+                    tracks_[index + 1].startFrame;
+        if (track.endFrame < track.startFrame)
+        {
+            throw QString("CUE track %1 overlaps next track.")
+                    .arg(track.number);
+        }
+        track.endFileOffset = calculateFileOffset(track.endFrame);
+        trackAreaStartFrame = track.endFrame;
+        trackAreaStartFileOffset = track.endFileOffset;
+    }
+}
+
+uint32_t CueSheet::parseMsf(QString const& msf)
+{
+    auto parts = msf.split(':');
+    if (parts.size() != 3)
+    { throwParseError(msf); }
+    uint32_t minutes = parts[0].toUInt();
+    uint32_t seconds = parts[1].toUInt();
+    uint32_t frames = parts[2].toUInt();
+    return (minutes * SECONDS_PER_MINUTE + seconds) * FRAMES_PER_SECOND +
+            frames;
+}
+
+void CueSheet::throwParseError(QString const& line)
+{ throw QString("Could not parse CUE sheet line \"%1\".").arg(line); }
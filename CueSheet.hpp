@@ -0,0 +1,52 @@
+#ifndef CUESHEET_HPP
+#define CUESHEET_HPP
+
+#include "CdImageLayout.hpp"
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+struct CueTrack
+{
+    static constexpr uint32_t UNTIL_FILE_END = 0;
+
+    uint32_t number;
+    QString filePath;
+    bool isData;
+    CdSectorMode sectorMode;
+    uint32_t sectorSize;
+    // Frames are counted from the start of track's file.
+    uint32_t startFrame;
+    uint32_t endFrame;
+    // Preceding tracks of the same file may have other sector sizes, so
+    // offsets are accumulated over them. End offset is 0 when track lasts
+    // until file end.
+    qint64 startFileOffset;
+    qint64 endFileOffset;
+};
+
+class CueSheet
+{
+public:
+    static CueSheet parse(QString const& cueFilePath);
+
+    QVector<CueTrack> const& tracks() const;
+    CueTrack const& firstDataTrack() const;
+
+private:
+    CueSheet() = default;
+
+    void parseLine(QString const& line, QString const& cueDirectory);
+    void parseFileLine(QString const& line, QString const& cueDirectory);
+    void parseTrackLine(QStringList const& tokens);
+    void parseIndexLine(QStringList const& tokens);
+    void calculateTracksBounds();
+    static uint32_t parseMsf(QString const& msf);
+    static void throwParseError(QString const& line);
+
+    QString currentFilePath_;
+    QVector<CueTrack> tracks_;
+    QVector<uint32_t> pregapStartFrames_;
+};
+
+#endif // CUESHEET_HPP
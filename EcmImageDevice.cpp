@@ -0,0 +1,320 @@
+#include "EcmImageDevice.hpp"
+#include "CdEdcEcc.hpp"
+#include <QFileInfo>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+static constexpr char ECM_MAGIC[] = {'E', 'C', 'M', '\0'};
+static constexpr uint32_t END_OF_RECORDS = 0xffffffff;
+static constexpr uint8_t SECTOR_SYNC[] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00
+};
+static constexpr uint32_t MODE_OFFSET = 0xf;
+static constexpr uint32_t SUBHEADER_OFFSET = 0x10;
+static constexpr uint32_t SUBHEADER_SIZE = 4;
+static constexpr uint32_t MODE1_DATA_OFFSET = 0x10;
+static constexpr uint32_t MODE2_DATA_OFFSET = 0x18;
+static constexpr uint32_t DATA_SIZE = 0x800;
+static constexpr uint32_t MODE2_FORM2_DATA_SIZE = 0x914;
+static constexpr uint32_t ADDRESS_SIZE = 3;
+static constexpr uint32_t MODE2_OUTPUT_OFFSET = 0x10;
+
+} // namespace
+
+EcmImageDevice::EcmImageDevice(QString const& ecmFilePath, QObject* parent)
+    : QIODevice(parent),
+      ecmFile_(ecmFilePath)
+{}
+
+bool EcmImageDevice::isEcmFile(QString const& filePath)
+{
+    auto fileSuffix = QFileInfo(filePath).suffix();
+    return fileSuffix.compare("ecm", Qt::CaseInsensitive) == 0;
+}
+
+bool EcmImageDevice::open(OpenMode mode)
+{
+    if ((mode & QIODevice::WriteOnly) != 0)
+    {
+        setErrorString("ECM image can be only read.");
+        return false;
+    }
+    if (!ecmFile_.open(QIODevice::ReadOnly))
+    {
+        setErrorString(ecmFile_.errorString());
+        return false;
+    }
+    try
+    { buildRecordsIndex(); }
+    catch (QString const& error)
+    {
+        ecmFile_.close();
+        setErrorString(error);
+        return false;
+    }
+    decodedUnitRecordIndex_ = -1;
+    decodedUnitIndex_ = NO_DECODED_UNIT;
+    // Decoded sectors are cached already, so readData can rely on pos().
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void EcmImageDevice::close()
+{
+    QIODevice::close();
+    ecmFile_.close();
+    records_.clear();
+    decodedSize_ = 0;
+}
+
+bool EcmImageDevice::isSequential() const
+{ return false; }
+
+qint64 EcmImageDevice::size() const
+{ return decodedSize_; }
+
+qint64 EcmImageDevice::readData(char* data, qint64 maxSize)
+{
+    qint64 offset = pos();
+    qint64 toRead = std::min(maxSize, decodedSize_ - offset);
+    if (toRead <= 0)
+    { return 0; }
+    qint64 readBytes = 0;
+    try
+    {
+        int recordIndex = findRecordIndex(offset);
+        while (readBytes < toRead)
+        {
+            auto const& record = records_[recordIndex];
+            auto unitSize = unitOutputSize(record.type);
+            qint64 recordEnd =
+                    record.outputOffset +
+                    static_cast<qint64>(record.count) * unitSize;
+            if (offset >= recordEnd)
+            {
+                ++recordIndex;
+                continue;
+            }
+            qint64 inRecordOffset = offset - record.outputOffset;
+            qint64 chunkSize;
+            if (record.type == RecordType::Raw)
+            {
+                chunkSize = std::min(toRead - readBytes, recordEnd - offset);
+                readInput(
+                            record.inputOffset + inRecordOffset,
+                            reinterpret_cast<uint8_t*>(data + readBytes),
+                            static_cast<uint32_t>(chunkSize));
+            }
+            else
+            {
+                auto unit = static_cast<uint32_t>(inRecordOffset / unitSize);
+                auto inUnitOffset = inRecordOffset % unitSize;
+                chunkSize = std::min<qint64>(
+                            toRead - readBytes,
+                            unitSize - inUnitOffset);
+                auto const* decodedUnit = decodeUnit(recordIndex, unit);
+                std::memcpy(
+                            data + readBytes,
+                            decodedUnit + inUnitOffset,
+                            chunkSize);
+            }
+            offset += chunkSize;
+            readBytes += chunkSize;
+        }
+    }
+    catch (QString const& error)
+    {
+        setErrorString(error);
+        return readBytes > 0 ? readBytes : -1;
+    }
+    return readBytes;
+}
+
+qint64 EcmImageDevice::writeData(char const*, qint64)
+{ return -1; }
+
+void EcmImageDevice::buildRecordsIndex()
+{
+    records_.clear();
+    decodedSize_ = 0;
+    char magic[sizeof(ECM_MAGIC)];
+    if (
+            ecmFile_.read(magic, sizeof(magic)) != sizeof(magic) ||
+            std::memcmp(magic, ECM_MAGIC, sizeof(magic)) != 0)
+    { throw QString("%1 is not an ECM file.").arg(ecmFile_.fileName()); }
+    RecordType type;
+    uint32_t count;
+    while (readRecordHeader(type, count))
+    {
+        Record record{decodedSize_, ecmFile_.pos(), type, count};
+        records_.append(record);
+        decodedSize_ += static_cast<qint64>(count) * unitOutputSize(type);
+        qint64 nextRecordOffset =
+                record.inputOffset +
+                static_cast<qint64>(count) * unitInputSize(type);
+        if (nextRecordOffset > ecmFile_.size())
+        { throw QString("ECM file is truncated."); }
+        ecmFile_.seek(nextRecordOffset);
+    }
+}
+
+bool EcmImageDevice::readRecordHeader(RecordType& type, uint32_t& count)
+{
+    uint8_t byte = readInputByte();
+    type = static_cast<RecordType>(byte & 0x3);
+    count = (byte >> 2) & 0x1f;
+    uint8_t shift = 5;
+    while ((byte & 0x80) != 0)
+    {
+        if (shift >= 32)
+        { throw QString("Invalid ECM record header."); }
+        byte = readInputByte();
+        count |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+    }
+    if (count == END_OF_RECORDS)
+    { return false; }
+    ++count;
+    return true;
+}
+
+uint8_t EcmImageDevice::readInputByte()
+{
+    char byte;
+    if (!ecmFile_.getChar(&byte))
+    { throw QString("ECM file is truncated."); }
+    return static_cast<uint8_t>(byte);
+}
+
+void EcmImageDevice::readInput(
+        qint64 inputOffset,
+        uint8_t* buffer,
+        uint32_t size)
+{
+    if (
+            !ecmFile_.seek(inputOffset) ||
+            ecmFile_.read(reinterpret_cast<char*>(buffer), size) != size)
+    {
+        throw QString("Could not read ECM data at 0x%1. %2")
+                .arg(inputOffset, 0, 16)
+                .arg(ecmFile_.errorString());
+    }
+}
+
+uint32_t EcmImageDevice::unitInputSize(RecordType type)
+{
+    switch (type)
+    {
+    case RecordType::Mode1:
+        return ADDRESS_SIZE + DATA_SIZE;
+    case RecordType::Mode2Form1:
+        return SUBHEADER_SIZE + DATA_SIZE;
+    case RecordType::Mode2Form2:
+        return SUBHEADER_SIZE + MODE2_FORM2_DATA_SIZE;
+    default:
+        return 1;
+    }
+}
+
+uint32_t EcmImageDevice::unitOutputSize(RecordType type)
+{
+    switch (type)
+    {
+    case RecordType::Mode1:
+        return RAW_SECTOR_SIZE;
+    case RecordType::Mode2Form1:
+    case RecordType::Mode2Form2:
+        return RAW_SECTOR_SIZE - MODE2_OUTPUT_OFFSET;
+    default:
+        return 1;
+    }
+}
+
+int EcmImageDevice::findRecordIndex(qint64 outputOffset) const
+{
+    auto it = std::upper_bound(
+                records_.cbegin(),
+                records_.cend(),
+                outputOffset,
+                [](qint64 offset, Record const& record) {
+        return offset < record.outputOffset;
+    });
+    if (it == records_.cbegin())
+    { throw QString("No ECM record at 0x%1.").arg(outputOffset, 0, 16); }
+    return static_cast<int>(it - records_.cbegin()) - 1;
+}
+
+uint8_t const* EcmImageDevice::decodeUnit(int recordIndex, uint32_t unit)
+{
+    if (decodedUnitRecordIndex_ == recordIndex && decodedUnitIndex_ == unit)
+    { return decodedUnitOutput_; }
+    auto const& record = records_[recordIndex];
+    auto inputSize = unitInputSize(record.type);
+    std::array<uint8_t, SUBHEADER_SIZE + MODE2_FORM2_DATA_SIZE> input;
+    readInput(
+                record.inputOffset + static_cast<qint64>(unit) * inputSize,
+                input.data(),
+                inputSize);
+    auto* sector = decodedUnit_.data();
+    std::memset(sector, 0, RAW_SECTOR_SIZE);
+    std::memcpy(sector, SECTOR_SYNC, sizeof(SECTOR_SYNC));
+    uint8_t const* output = sector;
+    switch (record.type)
+    {
+    case RecordType::Mode1:
+    {
+        std::memcpy(
+                    sector + CdEdcEcc::HEADER_OFFSET,
+                    input.data(),
+                    ADDRESS_SIZE);
+        sector[MODE_OFFSET] = 1;
+        std::memcpy(
+                    sector + MODE1_DATA_OFFSET,
+                    input.data() + ADDRESS_SIZE,
+                    DATA_SIZE);
+        auto edcOffset = MODE1_DATA_OFFSET + DATA_SIZE;
+        qToLittleEndian(
+                    CdEdcEcc::calculateEdc(sector, edcOffset),
+                    sector + edcOffset);
+        CdEdcEcc::generateEcc(sector);
+        break;
+    }
+    case RecordType::Mode2Form1:
+    case RecordType::Mode2Form2:
+    {
+        bool isForm1 = record.type == RecordType::Mode2Form1;
+        uint32_t dataSize = isForm1 ? DATA_SIZE : MODE2_FORM2_DATA_SIZE;
+        std::memcpy(sector + SUBHEADER_OFFSET, input.data(), SUBHEADER_SIZE);
+        std::memcpy(
+                    sector + SUBHEADER_OFFSET + SUBHEADER_SIZE,
+                    input.data(),
+                    SUBHEADER_SIZE);
+        std::memcpy(
+                    sector + MODE2_DATA_OFFSET,
+                    input.data() + SUBHEADER_SIZE,
+                    dataSize);
+        auto edcOffset = MODE2_DATA_OFFSET + dataSize;
+        qToLittleEndian(
+                    CdEdcEcc::calculateEdc(
+                        sector + SUBHEADER_OFFSET,
+                        edcOffset - SUBHEADER_OFFSET),
+                    sector + edcOffset);
+        // Header is zero here, as Mode 2 ECC requires. Sync and header are
+        // not part of ECM Mode 2 records output.
+        if (isForm1)
+        { CdEdcEcc::generateEcc(sector); }
+        output = sector + MODE2_OUTPUT_OFFSET;
+        break;
+    }
+    default:
+        throw QString("Unexpected ECM record type %1.")
+                .arg(static_cast<int>(record.type));
+    }
+    decodedUnitRecordIndex_ = recordIndex;
+    decodedUnitIndex_ = unit;
+    decodedUnitOutput_ = output;
+    return output;
+}
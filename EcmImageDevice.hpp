@@ -0,0 +1,68 @@
+#ifndef ECMIMAGEDEVICE_HPP
+#define ECMIMAGEDEVICE_HPP
+
+#include <QFile>
+#include <QIODevice>
+#include <QVector>
+#include <array>
+#include <cstdint>
+
+// Read-only random access device presenting an ECM compressed image as the
+// original image. ECM records are indexed during one forward pass on open,
+// sectors are then decoded and their sync, header, EDC and ECC regenerated
+// on demand.
+class EcmImageDevice : public QIODevice
+{
+    enum class RecordType : uint8_t
+    {
+        Raw = 0,
+        Mode1 = 1,
+        Mode2Form1 = 2,
+        Mode2Form2 = 3
+    };
+
+    struct Record
+    {
+        qint64 outputOffset;
+        qint64 inputOffset;
+        RecordType type;
+        uint32_t count;
+    };
+
+    static constexpr uint32_t RAW_SECTOR_SIZE = 0x930;
+    static constexpr uint32_t NO_DECODED_UNIT = static_cast<uint32_t>(-1);
+
+public:
+    EcmImageDevice(QString const& ecmFilePath, QObject* parent = nullptr);
+
+    static bool isEcmFile(QString const& filePath);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(char const* data, qint64 maxSize) override;
+
+private:
+    void buildRecordsIndex();
+    bool readRecordHeader(RecordType& type, uint32_t& count);
+    uint8_t readInputByte();
+    void readInput(qint64 inputOffset, uint8_t* buffer, uint32_t size);
+    static uint32_t unitInputSize(RecordType type);
+    static uint32_t unitOutputSize(RecordType type);
+    int findRecordIndex(qint64 outputOffset) const;
+    uint8_t const* decodeUnit(int recordIndex, uint32_t unit);
+
+    QFile ecmFile_;
+    QVector<Record> records_;
+    qint64 decodedSize_{0};
+    std::array<uint8_t, RAW_SECTOR_SIZE> decodedUnit_;
+    int decodedUnitRecordIndex_{-1};
+    uint32_t decodedUnitIndex_{NO_DECODED_UNIT};
+    uint8_t const* decodedUnitOutput_{nullptr};
+};
+
+#endif // ECMIMAGEDEVICE_HPP
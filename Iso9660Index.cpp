@@ -0,0 +1,220 @@
+#include "Iso9660Index.hpp"
+#include "BinCdImageReader.hpp"
+#include <QDataStream>
+#include <QFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+static constexpr uint32_t PRIMARY_VOLUME_DESCRIPTOR_SECTOR = 16;
+static constexpr uint8_t PRIMARY_VOLUME_DESCRIPTOR_TYPE = 1;
+static constexpr uint32_t ROOT_DIRECTORY_RECORD_OFFSET = 156;
+static constexpr uint32_t RECORD_EXTENT_OFFSET = 2;
+static constexpr uint32_t RECORD_SIZE_OFFSET = 10;
+static constexpr uint32_t RECORD_FLAGS_OFFSET = 25;
+static constexpr uint32_t RECORD_NAME_LENGTH_OFFSET = 32;
+static constexpr uint32_t RECORD_NAME_OFFSET = 33;
+static constexpr uint8_t RECORD_DIRECTORY_FLAG = 0x2;
+static constexpr uint32_t INDEX_FILE_MAGIC = 0x58444939;
+static constexpr uint32_t INDEX_FILE_VERSION = 1;
+
+bool isPathLess(Iso9660Index::Entry const& entry, QString const& path)
+{ return entry.path < path; }
+
+} // namespace
+
+uint32_t Iso9660Index::Entry::sectorsNumber() const
+{ return BinCdImageReader::calculateSectorsNumber(size); }
+
+Iso9660Index Iso9660Index::build(BinCdImageReader& reader)
+{
+    auto descriptor = reader.readSector(PRIMARY_VOLUME_DESCRIPTOR_SECTOR);
+    auto const* descriptorData =
+            reinterpret_cast<uint8_t const*>(descriptor.constData());
+    if (
+            descriptorData[0] != PRIMARY_VOLUME_DESCRIPTOR_TYPE ||
+            std::memcmp(descriptorData + 1, "CD001", 5) != 0)
+    { throw QString("No ISO9660 primary volume descriptor."); }
+    auto const* rootRecord = descriptorData + ROOT_DIRECTORY_RECORD_OFFSET;
+    Iso9660Index index;
+    QVector<uint32_t> visitedSectors;
+    index.readDirectory(
+                reader,
+                "",
+                qFromLittleEndian<uint32_t>(
+                    rootRecord + RECORD_EXTENT_OFFSET),
+                qFromLittleEndian<uint32_t>(rootRecord + RECORD_SIZE_OFFSET),
+                visitedSectors);
+    index.sort();
+    return index;
+}
+
+bool Iso9660Index::load(
+        QString const& indexFilePath,
+        QString const& imageFingerprint,
+        Iso9660Index& index)
+{
+    QFile indexFile(indexFilePath);
+    if (!indexFile.open(QIODevice::ReadOnly))
+    { return false; }
+    QDataStream indexStream(&indexFile);
+    quint32 magic;
+    quint32 version;
+    QString fingerprint;
+    quint32 entriesNumber;
+    indexStream >> magic >> version >> fingerprint >> entriesNumber;
+    if (
+            indexStream.status() != QDataStream::Ok ||
+            magic != INDEX_FILE_MAGIC ||
+            version != INDEX_FILE_VERSION ||
+            fingerprint != imageFingerprint)
+    { return false; }
+    Iso9660Index loadedIndex;
+    loadedIndex.entries_.reserve(entriesNumber);
+    for (quint32 i = 0; i < entriesNumber; ++i)
+    {
+        Entry entry;
+        quint32 sector;
+        quint32 size;
+        indexStream >> entry.path >> sector >> size >> entry.isDirectory;
+        entry.sector = sector;
+        entry.size = size;
+        loadedIndex.entries_.append(entry);
+    }
+    if (indexStream.status() != QDataStream::Ok)
+    { return false; }
+    loadedIndex.sort();
+    index = loadedIndex;
+    return true;
+}
+
+QString Iso9660Index::normalizePath(QString const& path)
+{
+    auto normalizedPath = path.trimmed().toUpper();
+    normalizedPath.replace('\\', '/');
+    if (normalizedPath.startsWith("CDROM:"))
+    { normalizedPath = normalizedPath.mid(6); }
+    auto versionSeparator = normalizedPath.lastIndexOf(';');
+    if (versionSeparator >= 0)
+    { normalizedPath.truncate(versionSeparator); }
+    if (normalizedPath.endsWith('.'))
+    { normalizedPath.chop(1); }
+    if (!normalizedPath.startsWith('/'))
+    { normalizedPath.prepend('/'); }
+    return normalizedPath;
+}
+
+bool Iso9660Index::isEmpty() const
+{ return entries_.isEmpty(); }
+
+QVector<Iso9660Index::Entry> const& Iso9660Index::entries() const
+{ return entries_; }
+
+Iso9660Index::Entry const* Iso9660Index::find(QString const& path) const
+{
+    auto normalizedPath = normalizePath(path);
+    auto it = std::lower_bound(
+                entries_.cbegin(),
+                entries_.cend(),
+                normalizedPath,
+                isPathLess);
+    if (it == entries_.cend() || it->path != normalizedPath)
+    { return nullptr; }
+    return &(*it);
+}
+
+void Iso9660Index::save(
+        QString const& indexFilePath,
+        QString const& imageFingerprint) const
+{
+    QFile indexFile(indexFilePath);
+    if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        throw QString("Could not open file %1. %2")
+                .arg(indexFilePath)
+                .arg(indexFile.errorString());
+    }
+    QDataStream indexStream(&indexFile);
+    indexStream << INDEX_FILE_MAGIC
+                << INDEX_FILE_VERSION
+                << imageFingerprint
+                << static_cast<quint32>(entries_.size());
+    for (auto const& entry : entries_)
+    {
+        indexStream << entry.path
+                    << static_cast<quint32>(entry.sector)
+                    << static_cast<quint32>(entry.size)
+                    << entry.isDirectory;
+    }
+}
+
+void Iso9660Index::readDirectory(
+        BinCdImageReader& reader,
+        QString const& directoryPath,
+        uint32_t sector,
+        uint32_t size,
+        QVector<uint32_t>& visitedSectors)
+{
+    if (visitedSectors.contains(sector))
+    { return; }
+    visitedSectors.append(sector);
+    auto directoryData = reader.readSectors(
+                sector,
+                BinCdImageReader::calculateSectorsNumber(size));
+    auto const* records =
+            reinterpret_cast<uint8_t const*>(directoryData.constData());
+    uint32_t offset = 0;
+    while (offset < size)
+    {
+        auto const* record = records + offset;
+        uint8_t recordSize = record[0];
+        if (recordSize == 0)
+        {
+            // Records don't cross sector boundaries, rest of sector is padding.
+            offset = (offset / BinCdImageReader::DATA_IN_SECTOR_SIZE + 1) *
+                    BinCdImageReader::DATA_IN_SECTOR_SIZE;
+            continue;
+        }
+        if (offset + recordSize > size)
+        { break; }
+        uint8_t nameLength = record[RECORD_NAME_LENGTH_OFFSET];
+        auto const* name =
+                reinterpret_cast<char const*>(record + RECORD_NAME_OFFSET);
+        offset += recordSize;
+        bool isSelfOrParent = nameLength == 1 && (name[0] == 0 || name[0] == 1);
+        if (isSelfOrParent || RECORD_NAME_OFFSET + nameLength > recordSize)
+        { continue; }
+        Entry entry;
+        entry.path = normalizePath(
+                    directoryPath + '/' +
+                    QString::fromLatin1(name, nameLength));
+        entry.sector =
+                qFromLittleEndian<uint32_t>(record + RECORD_EXTENT_OFFSET);
+        entry.size = qFromLittleEndian<uint32_t>(record + RECORD_SIZE_OFFSET);
+        entry.isDirectory =
+                (record[RECORD_FLAGS_OFFSET] & RECORD_DIRECTORY_FLAG) != 0;
+        entries_.append(entry);
+        if (entry.isDirectory)
+        {
+            readDirectory(
+                        reader,
+                        entry.path,
+                        entry.sector,
+                        entry.size,
+                        visitedSectors);
+        }
+    }
+}
+
+void Iso9660Index::sort()
+{
+    std::sort(
+                entries_.begin(),
+                entries_.end(),
+                [](Entry const& one, Entry const& other) {
+        return one.path < other.path;
+    });
+}
@@ -0,0 +1,56 @@
+#ifndef ISO9660INDEX_HPP
+#define ISO9660INDEX_HPP
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+class BinCdImageReader;
+
+// Sorted index of all files and directories of an ISO9660 file system.
+// Paths are absolute, upper case, use '/' separators and have no version
+// suffix, e.g. "/SLUS_011.65".
+class Iso9660Index
+{
+public:
+    struct Entry
+    {
+        QString path;
+        uint32_t sector;
+        uint32_t size;
+        bool isDirectory;
+
+        uint32_t sectorsNumber() const;
+    };
+
+    static Iso9660Index build(BinCdImageReader& reader);
+    // Returns false if index file doesn't exist or was created for image
+    // with different fingerprint.
+    static bool load(
+            QString const& indexFilePath,
+            QString const& imageFingerprint,
+            Iso9660Index& index);
+    static QString normalizePath(QString const& path);
+
+    bool isEmpty() const;
+    QVector<Entry> const& entries() const;
+    // Accepts paths in any case, with '\\' separators, "cdrom:" prefix and
+    // version suffix. Returns nullptr if there is no such file.
+    Entry const* find(QString const& path) const;
+    void save(
+            QString const& indexFilePath,
+            QString const& imageFingerprint) const;
+
+private:
+    void readDirectory(
+            BinCdImageReader& reader,
+            QString const& directoryPath,
+            uint32_t sector,
+            uint32_t size,
+            QVector<uint32_t>& visitedSectors);
+    void sort();
+
+    QVector<Entry> entries_;
+};
+
+#endif // ISO9660INDEX_HPP
@@ -3,6 +3,7 @@
 #include "AdResourceUnpacker.hpp"
 #include "AdResourcesIterator.hpp"
 #include <QCloseEvent>
+#include <QFile>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QProgressDialog>
@@ -67,7 +68,7 @@ void MainWindow::on_action_OpenCdImage_triggered()
                 this,
                 "Select CD image",
                 lastOpenCdImagePath_,
-                "BIN files (*.bin)");
+                "CD images (*.bin *.cue *.iso)");
                 */
     QString filePath("d:\\Isos\\PSX\\Azure Dreams\\Azure Dreams.bin");
     if (filePath.isEmpty())
@@ -111,6 +112,8 @@ void MainWindow::on_actionSaveAlImages_triggered()
             auto characterPortraitsData =
                     adMemoryHandler_->readCharacterPortraitsData(
                         speakerInfo.speakerId);
+            adMemoryHandler_->prefetchCharacterPortraits(
+                        characterPortraitsData);
             for (
                  uint32_t portraitVariant = 0;
                  portraitVariant < speakerInfo.variantsNumber;
@@ -188,6 +191,46 @@ void MainWindow::on_actionSaveAlImages_triggered()
     }
 }
 
+void MainWindow::on_actionTraceRamAccesses_toggled(bool isChecked)
+{
+    if (!isChecked)
+    {
+        adMemoryHandler_->setRamAccessTracer(nullptr);
+        return;
+    }
+    if (!ramAccessTracer_)
+    { ramAccessTracer_ = std::make_unique<RamAccessTracer>(); }
+    ramAccessTracer_->clear();
+    adMemoryHandler_->setRamAccessTracer(ramAccessTracer_.get());
+}
+
+void MainWindow::on_actionSaveRamAccessReport_triggered()
+{
+    QString const dialogTitle("Save RAM access report");
+    if (!ramAccessTracer_)
+    {
+        QMessageBox::information(
+                    this,
+                    dialogTitle,
+                    "Enable RAM access tracing first.");
+        return;
+    }
+    auto filePath = QFileDialog::getSaveFileName(
+                this,
+                dialogTitle,
+                QString(),
+                "Text files (*.txt)");
+    if (filePath.isEmpty())
+    { return; }
+    QFile reportFile(filePath);
+    if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QMessageBox::critical(this, dialogTitle, reportFile.errorString());
+        return;
+    }
+    reportFile.write(ramAccessTracer_->report(PsxRamConst::SIZE).toUtf8());
+}
+
 void MainWindow::onCharacterSelectionChanged()
 {
     clearPortrait();
@@ -212,6 +255,8 @@ void MainWindow::onCharacterSelectionChanged()
         selectedCharacterPortraitsData_ =
                 adMemoryHandler_->readCharacterPortraitsData(
                     speakerInfo.speakerId);
+        adMemoryHandler_->prefetchCharacterPortraits(
+                    selectedCharacterPortraitsData_);
     }
     catch (QString const& error)
     {
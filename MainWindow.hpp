@@ -5,6 +5,7 @@
 #include "AdMemoryHandler.hpp"
 #include "AdSpeakerId.hpp"
 #include "BinCdImageReader.hpp"
+#include "RamAccessTracer.hpp"
 #include "VirtualPsxRam.hpp"
 #include "VirtualPsxVRam.hpp"
 #include <QGraphicsScene>
@@ -29,6 +30,8 @@ protected:
 private slots:
     void on_action_OpenCdImage_triggered();
     void on_actionSaveAlImages_triggered();
+    void on_actionTraceRamAccesses_toggled(bool isChecked);
+    void on_actionSaveRamAccessReport_triggered();
     void onCharacterSelectionChanged();
     void onVariantSelectionChanged();
 
@@ -46,6 +49,8 @@ private:
     QSettings globalSettings_;
     QString lastOpenCdImagePath_;
     int selectedSpeakerIndex_{-1};
+    // Outlives memory handler, which refers to it while tracing is enabled.
+    std::unique_ptr<RamAccessTracer> ramAccessTracer_;
     std::unique_ptr<AdMemoryHandler> adMemoryHandler_;
     CharacterPortraitsData selectedCharacterPortraitsData_;
 };
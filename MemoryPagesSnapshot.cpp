@@ -0,0 +1,69 @@
+#include "MemoryPagesSnapshot.hpp"
+#include <cstring>
+
+MemoryPagesSnapshot::MemoryPagesSnapshot(uint32_t memorySize)
+    : memorySize_{memorySize},
+      savedPages_((memorySize + PAGE_SIZE - 1) >> PAGE_DEPTH),
+      pagesWrittenFlags_(savedPages_.size(), false)
+{}
+
+void MemoryPagesSnapshot::take()
+{
+    drop();
+    isTaken_ = true;
+}
+
+void MemoryPagesSnapshot::drop()
+{
+    for (auto& savedPage : savedPages_)
+    { savedPage.reset(); }
+    for (auto page : writtenPages_)
+    { pagesWrittenFlags_[page] = false; }
+    writtenPages_.clear();
+    isTaken_ = false;
+}
+
+void MemoryPagesSnapshot::restore(uint8_t* memory)
+{
+    // Saved pages are kept, they still hold snapshot content.
+    for (auto page : writtenPages_)
+    {
+        std::memcpy(
+                    memory + (page << PAGE_DEPTH),
+                    savedPages_[page].get(),
+                    pageSize(page));
+        pagesWrittenFlags_[page] = false;
+    }
+    writtenPages_.clear();
+}
+
+uint32_t MemoryPagesSnapshot::writtenPagesNumber() const
+{ return static_cast<uint32_t>(writtenPages_.size()); }
+
+uint32_t MemoryPagesSnapshot::pageSize(uint32_t page) const
+{
+    uint32_t pageOffset = page << PAGE_DEPTH;
+    return memorySize_ - pageOffset < PAGE_SIZE ?
+                memorySize_ - pageOffset :
+                PAGE_SIZE;
+}
+
+void MemoryPagesSnapshot::savePages(
+        uint8_t const* memory,
+        uint32_t firstPage,
+        uint32_t lastPage)
+{
+    for (uint32_t page = firstPage; page <= lastPage; ++page)
+    {
+        if (pagesWrittenFlags_[page])
+        { continue; }
+        pagesWrittenFlags_[page] = true;
+        writtenPages_.push_back(page);
+        auto& savedPage = savedPages_[page];
+        if (savedPage)
+        { continue; }
+        auto size = pageSize(page);
+        savedPage.reset(new uint8_t[size]);
+        std::memcpy(savedPage.get(), memory + (page << PAGE_DEPTH), size);
+    }
+}
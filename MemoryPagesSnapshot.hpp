@@ -0,0 +1,52 @@
+#ifndef MEMORYPAGESSNAPSHOT_HPP
+#define MEMORYPAGESSNAPSHOT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Copy-on-write snapshot of a memory buffer split into pages. Taking it only
+// resets pages tracking, content of a page is saved when the page is first
+// written after that. Restoring reverts written pages only.
+class MemoryPagesSnapshot
+{
+public:
+    static constexpr uint8_t PAGE_DEPTH = 12;
+    static constexpr uint32_t PAGE_SIZE = 1 << PAGE_DEPTH;
+
+    explicit MemoryPagesSnapshot(uint32_t memorySize);
+
+    bool isTaken() const
+    { return isTaken_; }
+    void take();
+    void drop();
+    // Has to be called before size bytes of memory at offset are written.
+    inline void prepareWrite(
+            uint8_t const* memory,
+            uint32_t offset,
+            uint32_t size)
+    {
+        if (isTaken_ && size > 0)
+        {
+            savePages(
+                        memory,
+                        offset >> PAGE_DEPTH,
+                        (offset + size - 1) >> PAGE_DEPTH);
+        }
+    }
+    // Reverts pages written since snapshot was taken or last restored.
+    void restore(uint8_t* memory);
+    uint32_t writtenPagesNumber() const;
+
+private:
+    uint32_t pageSize(uint32_t page) const;
+    void savePages(uint8_t const* memory, uint32_t firstPage, uint32_t lastPage);
+
+    uint32_t memorySize_;
+    bool isTaken_{false};
+    std::vector<std::unique_ptr<uint8_t[]>> savedPages_;
+    std::vector<bool> pagesWrittenFlags_;
+    std::vector<uint32_t> writtenPages_;
+};
+
+#endif // MEMORYPAGESSNAPSHOT_HPP
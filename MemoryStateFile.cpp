@@ -0,0 +1,263 @@
+#include "MemoryStateFile.hpp"
+#include "VirtualPsxVRam.hpp"
+#include <QDataStream>
+#include <QFile>
+#include <algorithm>
+
+namespace
+{
+
+static constexpr uint32_t STATE_FILE_MAGIC = 0x58444d53;
+static constexpr uint32_t STATE_FILE_VERSION = 2;
+
+using PendingRegions = QVector<VirtualPsxRam::PendingRegion>;
+
+qint64 calculateRectDataSize(QRect const& rect)
+{
+    return static_cast<qint64>(rect.width()) * rect.height() *
+            PsxVRamConst::PIXEL_SIZE;
+}
+
+// Parts of initialized regions which are not pending, only their content is
+// stored. Both regions are sorted and pending regions lie inside initialized
+// ones.
+QVector<PsxRamAddress::Region> calculateLoadedRegions(
+        QVector<PsxRamAddress::Region> const& regions,
+        PendingRegions const& pendingRegions)
+{
+    QVector<PsxRamAddress::Region> loadedRegions;
+    int pendingIndex = 0;
+    for (auto const& region : regions)
+    {
+        uint32_t loadedBegin = region.address.raw();
+        uint32_t regionEnd = loadedBegin + region.size;
+        while (
+               pendingIndex < pendingRegions.size() &&
+               pendingRegions[pendingIndex].region.address.raw() < regionEnd)
+        {
+            auto const& pendingRegion = pendingRegions[pendingIndex].region;
+            uint32_t pendingBegin = pendingRegion.address.raw();
+            if (loadedBegin < pendingBegin)
+            { loadedRegions.append({loadedBegin, pendingBegin - loadedBegin}); }
+            loadedBegin = pendingBegin + pendingRegion.size;
+            ++pendingIndex;
+        }
+        if (loadedBegin < regionEnd)
+        { loadedRegions.append({loadedBegin, regionEnd - loadedBegin}); }
+    }
+    return loadedRegions;
+}
+
+bool isInRegions(
+        QVector<PsxRamAddress::Region> const& regions,
+        PsxRamAddress::Region const& checkedRegion)
+{
+    return std::any_of(
+                regions.cbegin(),
+                regions.cend(),
+                [&](PsxRamAddress::Region const& region) {
+        return region.doesContain(checkedRegion);
+    });
+}
+
+} // namespace
+
+bool MemoryStateFile::load(
+        QString const& stateFilePath,
+        QString const& imageFingerprint,
+        LazyDataReaderFactory const& lazyDataReaderFactory,
+        bool isLazyLoadingEnabled,
+        VirtualPsxRam& ram,
+        VirtualPsxVRam& vram)
+{
+    ram.clear();
+    vram.clear();
+    QFile stateFile(stateFilePath);
+    if (!stateFile.open(QIODevice::ReadOnly))
+    { return false; }
+    QDataStream stateStream(&stateFile);
+    quint32 magic;
+    quint32 version;
+    QString fingerprint;
+    quint32 regionsNumber;
+    stateStream >> magic >> version >> fingerprint >> regionsNumber;
+    if (
+            stateStream.status() != QDataStream::Ok ||
+            magic != STATE_FILE_MAGIC ||
+            version != STATE_FILE_VERSION ||
+            fingerprint != imageFingerprint)
+    { return false; }
+    QVector<PsxRamAddress::Region> regions;
+    for (quint32 i = 0; i < regionsNumber; ++i)
+    {
+        quint32 address;
+        quint32 size;
+        stateStream >> address >> size;
+        if (stateStream.status() != QDataStream::Ok || size == 0)
+        { return false; }
+        if (!regions.isEmpty() && address <= regions.last().end().raw())
+        { return false; }
+        regions.append({address, size});
+    }
+    quint32 pendingRegionsNumber;
+    stateStream >> pendingRegionsNumber;
+    PendingRegions pendingRegions;
+    for (quint32 i = 0; i < pendingRegionsNumber; ++i)
+    {
+        quint32 address;
+        quint32 size;
+        quint32 dataId;
+        quint32 dataOffset;
+        stateStream >> address >> size >> dataId >> dataOffset;
+        PsxRamAddress::Region region{address, size};
+        if (
+                stateStream.status() != QDataStream::Ok ||
+                size == 0 ||
+                !isInRegions(regions, region))
+        { return false; }
+        if (
+                !pendingRegions.isEmpty() &&
+                address <= pendingRegions.last().region.end().raw())
+        { return false; }
+        pendingRegions.append({region, dataId, dataOffset});
+    }
+    auto loadedRegions = calculateLoadedRegions(regions, pendingRegions);
+    qint64 dataSize = 0;
+    for (auto const& loadedRegion : loadedRegions)
+    { dataSize += loadedRegion.size; }
+    quint32 rectsNumber;
+    stateStream >> rectsNumber;
+    QVector<QRect> rects;
+    for (quint32 i = 0; i < rectsNumber; ++i)
+    {
+        qint32 x;
+        qint32 y;
+        qint32 width;
+        qint32 height;
+        stateStream >> x >> y >> width >> height;
+        QRect rect(x, y, width, height);
+        if (stateStream.status() != QDataStream::Ok || rect.isEmpty())
+        { return false; }
+        rects.append(rect);
+        dataSize += calculateRectDataSize(rect);
+    }
+    if (stateStream.status() != QDataStream::Ok)
+    { return false; }
+    qint64 dataOffset = stateFile.pos();
+    if (dataOffset + dataSize != stateFile.size())
+    { return false; }
+    if (dataSize == 0)
+    { return true; }
+    auto const* data = stateFile.map(dataOffset, dataSize);
+    if (data == nullptr)
+    { return false; }
+    try
+    {
+        for (auto const& loadedRegion : loadedRegions)
+        {
+            ram.load(data, loadedRegion.size, loadedRegion.address);
+            data += loadedRegion.size;
+        }
+        QByteArray pendingData;
+        for (auto const& pendingRegion : pendingRegions)
+        {
+            auto dataReader = lazyDataReaderFactory(pendingRegion.dataId);
+            if (!isLazyLoadingEnabled)
+            {
+                pendingData.resize(
+                            static_cast<int>(pendingRegion.region.size));
+                dataReader(
+                            pendingRegion.dataOffset,
+                            reinterpret_cast<uint8_t*>(pendingData.data()),
+                            pendingRegion.region.size);
+                ram.load(pendingData, pendingRegion.region.address);
+                continue;
+            }
+            ram.loadLazily(
+                        pendingRegion.region.address,
+                        pendingRegion.region.size,
+                        pendingRegion.dataId,
+                        dataReader,
+                        pendingRegion.dataOffset);
+        }
+        for (auto const& rect : rects)
+        {
+            auto rectDataSize = static_cast<uint32_t>(
+                        calculateRectDataSize(rect));
+            vram.load(data, rectDataSize, rect);
+            data += rectDataSize;
+        }
+    }
+    catch (QString const&)
+    {
+        ram.clear();
+        vram.clear();
+        return false;
+    }
+    return true;
+}
+
+void MemoryStateFile::save(
+        QString const& stateFilePath,
+        QString const& imageFingerprint,
+        VirtualPsxRam const& ram,
+        VirtualPsxVRam const& vram)
+{
+    QFile stateFile(stateFilePath);
+    if (!stateFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        throw QString("Could not open file %1. %2")
+                .arg(stateFilePath)
+                .arg(stateFile.errorString());
+    }
+    auto const& regions = ram.initializedRegions();
+    auto pendingRegions = ram.pendingRegions();
+    auto const& rects = vram.initializedRects();
+    QDataStream stateStream(&stateFile);
+    stateStream << STATE_FILE_MAGIC
+                << STATE_FILE_VERSION
+                << imageFingerprint
+                << static_cast<quint32>(regions.size());
+    for (auto const& region : regions)
+    {
+        stateStream << static_cast<quint32>(region.address.raw())
+                    << static_cast<quint32>(region.size);
+    }
+    stateStream << static_cast<quint32>(pendingRegions.size());
+    for (auto const& pendingRegion : pendingRegions)
+    {
+        stateStream << static_cast<quint32>(pendingRegion.region.address.raw())
+                    << static_cast<quint32>(pendingRegion.region.size)
+                    << static_cast<quint32>(pendingRegion.dataId)
+                    << static_cast<quint32>(pendingRegion.dataOffset);
+    }
+    stateStream << static_cast<quint32>(rects.size());
+    for (auto const& rect : rects)
+    {
+        stateStream << static_cast<qint32>(rect.x())
+                    << static_cast<qint32>(rect.y())
+                    << static_cast<qint32>(rect.width())
+                    << static_cast<qint32>(rect.height());
+    }
+    // Pending pages are skipped, so saving doesn't read them.
+    auto loadedRegions = calculateLoadedRegions(regions, pendingRegions);
+    QByteArray data;
+    for (auto const& loadedRegion : loadedRegions)
+    {
+        data.resize(loadedRegion.size);
+        ram.readRegion(loadedRegion, reinterpret_cast<uint8_t*>(data.data()));
+        stateStream.writeRawData(data.constData(), data.size());
+    }
+    for (auto const& rect : rects)
+    {
+        data.resize(calculateRectDataSize(rect));
+        vram.readRect(rect, reinterpret_cast<uint8_t*>(data.data()));
+        stateStream.writeRawData(data.constData(), data.size());
+    }
+    if (stateStream.status() != QDataStream::Ok)
+    {
+        throw QString("Could not write file %1. %2")
+                .arg(stateFilePath)
+                .arg(stateFile.errorString());
+    }
+}
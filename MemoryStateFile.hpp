@@ -0,0 +1,40 @@
+#ifndef MEMORYSTATEFILE_HPP
+#define MEMORYSTATEFILE_HPP
+
+#include "VirtualPsxRam.hpp"
+#include <QString>
+#include <functional>
+
+class VirtualPsxVRam;
+
+// Persisted contents of RAM and VRAM. Only initialized regions and rects are
+// stored, their data follows the header back to back, so it is mapped and
+// copied into the memories directly. RAM pages not read from their lazy loads
+// yet are stored as references to their data, so they stay lazy.
+class MemoryStateFile
+{
+public:
+    // Creates reader of identified data for pages which stay lazy.
+    using LazyDataReaderFactory = std::function<
+            VirtualPsxRam::LazyDataReader(VirtualPsxRam::LazyDataId dataId)>;
+
+    MemoryStateFile() = delete;
+
+    // Returns false if state file doesn't exist, was created for image with
+    // different fingerprint or is corrupt. Memories are cleared then. When
+    // lazy loading is disabled, stored references are read right away.
+    static bool load(
+            QString const& stateFilePath,
+            QString const& imageFingerprint,
+            LazyDataReaderFactory const& lazyDataReaderFactory,
+            bool isLazyLoadingEnabled,
+            VirtualPsxRam& ram,
+            VirtualPsxVRam& vram);
+    static void save(
+            QString const& stateFilePath,
+            QString const& imageFingerprint,
+            VirtualPsxRam const& ram,
+            VirtualPsxVRam const& vram);
+};
+
+#endif // MEMORYSTATEFILE_HPP
@@ -0,0 +1,52 @@
+#ifndef PSXRAMVIEW_HPP
+#define PSXRAMVIEW_HPP
+
+#include "PsxRamAddress.hpp"
+#include <QString>
+#include <cstdint>
+
+// Read-only array of structs placed in PSX RAM. Whole array is checked to be
+// initialized when view is created, so elements are accessed without copies
+// and checks. View reflects later writes to viewed region.
+template <typename T>
+class PsxRamView
+{
+public:
+    PsxRamView(T const* data, uint32_t size, PsxRamAddress address)
+        : data_{data}, size_{size}, address_{address}
+    {}
+
+    uint32_t size() const
+    { return size_; }
+    bool isEmpty() const
+    { return size_ == 0; }
+    T const* begin() const
+    { return data_; }
+    T const* end() const
+    { return data_ + size_; }
+    T const& operator[](uint32_t index) const
+    { return data_[index]; }
+    // Throws if element is beyond viewed region, e.g. when a terminated
+    // table runs past initialized memory.
+    T const& at(uint32_t index) const
+    {
+        if (index >= size_)
+        {
+            throw QString(
+                        "Read from uninitialized region (address: 0x%1, "
+                        "size: 0x%2).")
+                    .arg(address(index).raw(), 0, 16)
+                    .arg(sizeof(T), 0, 16);
+        }
+        return data_[index];
+    }
+    PsxRamAddress address(uint32_t index) const
+    { return address_ + index * static_cast<uint32_t>(sizeof(T)); }
+
+private:
+    T const* data_;
+    uint32_t size_;
+    PsxRamAddress address_;
+};
+
+#endif // PSXRAMVIEW_HPP
@@ -0,0 +1,193 @@
+#include "RamAccessTracer.hpp"
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <algorithm>
+
+namespace
+{
+
+QString operationName(char const* operation)
+{ return operation != nullptr ? QString(operation) : QString("<none>"); }
+
+} // namespace
+
+RamAccessTracer::OperationScope::OperationScope(
+        RamAccessTracer* tracer,
+        char const* operation)
+    : tracer_{tracer},
+      previousOperation_{nullptr}
+{
+    if (tracer_ == nullptr)
+    { return; }
+    previousOperation_ = tracer_->operation();
+    tracer_->setOperation(operation);
+}
+
+RamAccessTracer::OperationScope::~OperationScope()
+{
+    if (tracer_ != nullptr)
+    { tracer_->setOperation(previousOperation_); }
+}
+
+RamAccessTracer::RamAccessTracer(uint8_t capacityDepth)
+    : records_(static_cast<std::size_t>(1) << capacityDepth),
+      recordIndexMask_{(static_cast<uint64_t>(1) << capacityDepth) - 1}
+{}
+
+void RamAccessTracer::setOperation(char const* operation)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    operation_ = operation;
+}
+
+char const* RamAccessTracer::operation() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return operation_;
+}
+
+void RamAccessTracer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    nextRecordIndex_ = 0;
+}
+
+uint64_t RamAccessTracer::recordedNumber() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return nextRecordIndex_;
+}
+
+QVector<RamAccessTracer::Record> RamAccessTracer::records() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t recordedNumber = nextRecordIndex_;
+    uint64_t keptNumber = std::min<uint64_t>(recordedNumber, records_.size());
+    QVector<Record> keptRecords;
+    keptRecords.reserve(static_cast<int>(keptNumber));
+    for (
+         uint64_t index = recordedNumber - keptNumber;
+         index < recordedNumber;
+         ++index)
+    { keptRecords.append(records_[index & recordIndexMask_]); }
+    return keptRecords;
+}
+
+QVector<uint32_t> RamAccessTracer::pagesHeatMap(uint32_t ramSize) const
+{
+    QVector<uint32_t> heatMap((ramSize + (1 << PAGE_DEPTH) - 1) >> PAGE_DEPTH);
+    for (auto const& record : records())
+    {
+        uint32_t lastByte = record.size > 0 ?
+                    record.address + record.size - 1 :
+                    record.address;
+        for (
+             uint32_t page = record.address >> PAGE_DEPTH;
+             page <= lastByte >> PAGE_DEPTH &&
+             page < static_cast<uint32_t>(heatMap.size());
+             ++page)
+        { ++heatMap[page]; }
+    }
+    return heatMap;
+}
+
+QVector<RamAccessTracer::OperationStatistics>
+RamAccessTracer::operationsStatistics() const
+{
+    QHash<char const*, OperationStatistics> statisticsByOperation;
+    QSet<QPair<char const*, uint32_t>> accessedAddresses;
+    for (auto const& record : records())
+    {
+        auto& statistics = statisticsByOperation[record.operation];
+        statistics.operation = record.operation;
+        ++statistics.accessesNumber;
+        statistics.bytesNumber += record.size;
+        QPair<char const*, uint32_t> accessedAddress(
+                    record.operation,
+                    record.address);
+        if (accessedAddresses.contains(accessedAddress))
+        { ++statistics.repeatedAccessesNumber; }
+        else
+        { accessedAddresses.insert(accessedAddress); }
+    }
+    QVector<OperationStatistics> operationsStatistics;
+    operationsStatistics.reserve(statisticsByOperation.size());
+    for (
+         auto it = statisticsByOperation.cbegin();
+         it != statisticsByOperation.cend();
+         ++it)
+    { operationsStatistics.append(it.value()); }
+    std::sort(
+                operationsStatistics.begin(),
+                operationsStatistics.end(),
+                [](OperationStatistics const& a, OperationStatistics const& b) {
+        return a.accessesNumber > b.accessesNumber;
+    });
+    return operationsStatistics;
+}
+
+QVector<RamAccessTracer::TableStatistics>
+RamAccessTracer::tablesStatistics() const
+{
+    QHash<uint32_t, TableStatistics> statisticsByAddress;
+    for (auto const& record : records())
+    {
+        if (record.type != AccessType::View)
+        { continue; }
+        auto& statistics = statisticsByAddress[record.address];
+        statistics.address = record.address;
+        statistics.operation = record.operation;
+        ++statistics.viewsNumber;
+    }
+    QVector<TableStatistics> tablesStatistics;
+    tablesStatistics.reserve(statisticsByAddress.size());
+    for (
+         auto it = statisticsByAddress.cbegin();
+         it != statisticsByAddress.cend();
+         ++it)
+    { tablesStatistics.append(it.value()); }
+    std::sort(
+                tablesStatistics.begin(),
+                tablesStatistics.end(),
+                [](TableStatistics const& a, TableStatistics const& b) {
+        return a.viewsNumber > b.viewsNumber;
+    });
+    return tablesStatistics;
+}
+
+QString RamAccessTracer::report(uint32_t ramSize) const
+{
+    QString report = QString("Recorded accesses: %1 (kept %2)\n")
+            .arg(recordedNumber())
+            .arg(records().size());
+    report += "Operations:\n";
+    for (auto const& statistics : operationsStatistics())
+    {
+        report += QString("  %1: %2 accesses, %3 repeated, 0x%4 bytes\n")
+                .arg(operationName(statistics.operation))
+                .arg(statistics.accessesNumber)
+                .arg(statistics.repeatedAccessesNumber)
+                .arg(statistics.bytesNumber, 0, 16);
+    }
+    report += "Tables:\n";
+    for (auto const& statistics : tablesStatistics())
+    {
+        report += QString("  0x%1 (%2): %3 views\n")
+                .arg(statistics.address, 8, 16, QChar('0'))
+                .arg(operationName(statistics.operation))
+                .arg(statistics.viewsNumber);
+    }
+    report += "Pages:\n";
+    auto heatMap = pagesHeatMap(ramSize);
+    for (int page = 0; page < heatMap.size(); ++page)
+    {
+        if (heatMap[page] == 0)
+        { continue; }
+        uint32_t pageAddress = static_cast<uint32_t>(page) << PAGE_DEPTH;
+        report += QString("  0x%1: %2\n")
+                .arg(pageAddress, 8, 16, QChar('0'))
+                .arg(heatMap[page]);
+    }
+    return report;
+}
@@ -0,0 +1,99 @@
+#ifndef RAMACCESSTRACER_HPP
+#define RAMACCESSTRACER_HPP
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Records RAM accesses into a ring buffer, the oldest records are overwritten
+// when it is full. Records and current operation are guarded by a mutex, so
+// accesses may be recorded from several threads while records are read.
+class RamAccessTracer
+{
+public:
+    static constexpr uint8_t DEFAULT_CAPACITY_DEPTH = 16;
+    static constexpr uint8_t PAGE_DEPTH = 12;
+
+    enum class AccessType : uint8_t
+    {
+        Read,
+        // Validated region accessed in place, e.g. a table.
+        View,
+        Write
+    };
+
+    struct Record
+    {
+        // Operation which was set when access was made, may be null.
+        char const* operation;
+        uint32_t address;
+        uint32_t size;
+        AccessType type;
+    };
+
+    struct OperationStatistics
+    {
+        char const* operation;
+        uint32_t accessesNumber;
+        // Accesses to an address already accessed by the operation before.
+        uint32_t repeatedAccessesNumber;
+        uint64_t bytesNumber;
+    };
+
+    struct TableStatistics
+    {
+        uint32_t address;
+        char const* operation;
+        uint32_t viewsNumber;
+    };
+
+    // Sets operation of later records and restores previous one when
+    // destroyed. Does nothing for null tracer.
+    class OperationScope
+    {
+    public:
+        OperationScope(RamAccessTracer* tracer, char const* operation);
+        ~OperationScope();
+        OperationScope(OperationScope const&) = delete;
+        OperationScope& operator=(OperationScope const&) = delete;
+
+    private:
+        RamAccessTracer* tracer_;
+        char const* previousOperation_;
+    };
+
+    explicit RamAccessTracer(uint8_t capacityDepth = DEFAULT_CAPACITY_DEPTH);
+
+    // Operation has to outlive the tracer, e.g. a string literal.
+    void setOperation(char const* operation);
+    char const* operation() const;
+    inline void record(AccessType type, uint32_t address, uint32_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto index = nextRecordIndex_++;
+        records_[index & recordIndexMask_] = {operation_, address, size, type};
+    }
+    void clear();
+    // Counts overwritten records too.
+    uint64_t recordedNumber() const;
+    // Kept records, the oldest first.
+    QVector<Record> records() const;
+    // Number of accesses touching each page of RAM.
+    QVector<uint32_t> pagesHeatMap(uint32_t ramSize) const;
+    // Sorted by number of accesses, descending.
+    QVector<OperationStatistics> operationsStatistics() const;
+    // Views grouped by viewed address, sorted by number of views, descending.
+    QVector<TableStatistics> tablesStatistics() const;
+    QString report(uint32_t ramSize) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<Record> records_;
+    uint64_t recordIndexMask_;
+    uint64_t nextRecordIndex_{0};
+    char const* operation_{nullptr};
+};
+
+#endif // RAMACCESSTRACER_HPP
@@ -0,0 +1,95 @@
+#include "SectorCache.hpp"
+#include <cstring>
+
+SectorCache::SectorCache(uint32_t budget)
+    : budget_{budget}
+{}
+
+uint32_t SectorCache::budget() const
+{ return budget_; }
+
+void SectorCache::setBudget(uint32_t budget)
+{
+    budget_ = budget;
+    evictToBudget();
+}
+
+bool SectorCache::fetch(uint32_t sector, uint8_t* buffer, uint32_t size)
+{
+    auto it = entriesBySector_.find(sector);
+    if (it == entriesBySector_.end())
+    { return false; }
+    auto entryIt = it.value();
+    if (static_cast<uint32_t>(entryIt->data.size()) != size)
+    { return false; }
+    entries_.splice(entries_.begin(), entries_, entryIt);
+    std::memcpy(buffer, entryIt->data.constData(), size);
+    ++hits_;
+    return true;
+}
+
+bool SectorCache::contains(uint32_t sector) const
+{ return entriesBySector_.contains(sector); }
+
+void SectorCache::recordMisses(uint32_t missesNumber)
+{ misses_ += missesNumber; }
+
+void SectorCache::insert(uint32_t sector, uint8_t const* data, uint32_t size)
+{
+    if (size > budget_)
+    { return; }
+    auto it = entriesBySector_.find(sector);
+    if (it != entriesBySector_.end())
+    {
+        auto entryIt = it.value();
+        usedBytes_ -= entryIt->data.size();
+        entryIt->data = QByteArray(reinterpret_cast<char const*>(data), size);
+        entries_.splice(entries_.begin(), entries_, entryIt);
+    }
+    else
+    {
+        QByteArray entryData(reinterpret_cast<char const*>(data), size);
+        entries_.push_front({sector, entryData});
+        entriesBySector_.insert(sector, entries_.begin());
+    }
+    usedBytes_ += size;
+    evictToBudget();
+}
+
+void SectorCache::clear()
+{
+    entries_.clear();
+    entriesBySector_.clear();
+    usedBytes_ = 0;
+}
+
+SectorCache::Statistics SectorCache::statistics() const
+{
+    return {
+        hits_,
+        misses_,
+        evictions_,
+        static_cast<uint32_t>(entriesBySector_.size()),
+        usedBytes_,
+        budget_
+    };
+}
+
+void SectorCache::resetStatistics()
+{
+    hits_ = 0;
+    misses_ = 0;
+    evictions_ = 0;
+}
+
+void SectorCache::evictToBudget()
+{
+    while (usedBytes_ > budget_ && !entries_.empty())
+    {
+        auto const& leastRecentlyUsed = entries_.back();
+        usedBytes_ -= leastRecentlyUsed.data.size();
+        entriesBySector_.remove(leastRecentlyUsed.sector);
+        entries_.pop_back();
+        ++evictions_;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SECTORCACHE_HPP
+#define SECTORCACHE_HPP
+
+#include <QByteArray>
+#include <QHash>
+#include <cstdint>
+#include <list>
+
+// Least recently used cache of sectors data keyed by sector number. Size of
+// the cache is limited by a budget of stored data bytes.
+class SectorCache
+{
+    struct Entry
+    {
+        uint32_t sector;
+        QByteArray data;
+    };
+    using Entries = std::list<Entry>;
+
+public:
+    static constexpr uint32_t DEFAULT_BUDGET = 0x400000;
+
+    struct Statistics
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint32_t sectorsNumber;
+        uint32_t usedBytes;
+        uint32_t budget;
+    };
+
+    SectorCache(uint32_t budget = DEFAULT_BUDGET);
+
+    uint32_t budget() const;
+    void setBudget(uint32_t budget);
+    // Counts a hit on success. Misses are counted by recordMisses() for
+    // every sector then read from the image, so neither fetch() failures
+    // nor contains() probes count.
+    bool fetch(uint32_t sector, uint8_t* buffer, uint32_t size);
+    bool contains(uint32_t sector) const;
+    void recordMisses(uint32_t missesNumber);
+    void insert(uint32_t sector, uint8_t const* data, uint32_t size);
+    void clear();
+    Statistics statistics() const;
+    void resetStatistics();
+
+private:
+    void evictToBudget();
+
+    uint32_t budget_;
+    uint32_t usedBytes_{0};
+    Entries entries_;
+    QHash<uint32_t, Entries::iterator> entriesBySector_;
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+    uint64_t evictions_{0};
+};
+
+#endif // SECTORCACHE_HPP
@@ -0,0 +1,90 @@
+#include "SectorPrefetcher.hpp"
+#include <QString>
+
+SectorPrefetcher::SectorPrefetcher(SectorsLoader sectorsLoader)
+    : sectorsLoader_{std::move(sectorsLoader)},
+      thread_{&SectorPrefetcher::run, this}
+{}
+
+SectorPrefetcher::~SectorPrefetcher()
+{
+    cancel();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    requestsCondition_.notify_one();
+    thread_.join();
+}
+
+SectorPrefetcher::PrefetchFuture SectorPrefetcher::prefetch(
+        uint32_t startSector,
+        uint32_t sectorsNumber)
+{
+    Request request{startSector, sectorsNumber, {}};
+    auto future = request.promise.get_future().share();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.push_back(std::move(request));
+    }
+    requestsCondition_.notify_one();
+    return future;
+}
+
+void SectorPrefetcher::cancel()
+{
+    Requests cancelledRequests;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+        cancelledRequests.swap(requests_);
+    }
+    for (auto& request : cancelledRequests)
+    { request.promise.set_value(false); }
+}
+
+void SectorPrefetcher::run()
+{
+    while (true)
+    {
+        Request request;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            requestsCondition_.wait(
+                        lock,
+                        [this]() { return stopped_ || !requests_.empty(); });
+            if (stopped_)
+            { return; }
+            request = std::move(requests_.front());
+            requests_.pop_front();
+            generation = generation_;
+        }
+        try
+        { request.promise.set_value(load(request, generation)); }
+        catch (...)
+        {
+            // Anything escaping the worker thread would terminate the
+            // program, e.g. std::bad_alloc, so it goes to the waiter.
+            request.promise.set_exception(std::current_exception());
+        }
+    }
+}
+
+bool SectorPrefetcher::load(Request& request, uint64_t generation)
+{
+    uint32_t sector = request.startSector;
+    uint32_t const endSector = request.startSector + request.sectorsNumber;
+    while (sector < endSector)
+    {
+        if (generation_ != generation)
+        { return false; }
+        uint32_t chunkSectorsNumber = endSector - sector;
+        if (chunkSectorsNumber > CHUNK_SECTORS_NUMBER)
+        { chunkSectorsNumber = CHUNK_SECTORS_NUMBER; }
+        if (!sectorsLoader_(sector, chunkSectorsNumber))
+        { return false; }
+        sector += chunkSectorsNumber;
+    }
+    return true;
+}
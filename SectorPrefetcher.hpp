@@ -0,0 +1,58 @@
+#ifndef SECTORPREFETCHER_HPP
+#define SECTORPREFETCHER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// Background thread which executes announced sector range loads in
+// announcement order. Range is loaded in chunks, so cancel() stops also an
+// already started load after its current chunk.
+class SectorPrefetcher
+{
+public:
+    static constexpr uint32_t CHUNK_SECTORS_NUMBER = 0x40;
+
+    // Loads given range. Returns false if range can't be prefetched.
+    using SectorsLoader =
+            std::function<bool(uint32_t startSector, uint32_t sectorsNumber)>;
+    // Future is set to true when whole range was loaded and to false when
+    // loading was cancelled or not possible. Load errors are passed as
+    // QString exceptions.
+    using PrefetchFuture = std::shared_future<bool>;
+
+    SectorPrefetcher(SectorsLoader sectorsLoader);
+    ~SectorPrefetcher();
+
+    PrefetchFuture prefetch(uint32_t startSector, uint32_t sectorsNumber);
+    void cancel();
+
+private:
+    struct Request
+    {
+        uint32_t startSector;
+        uint32_t sectorsNumber;
+        std::promise<bool> promise;
+    };
+    using Requests = std::deque<Request>;
+
+    SectorPrefetcher(SectorPrefetcher const&) = delete;
+
+    void run();
+    bool load(Request& request, uint64_t generation);
+
+    SectorsLoader sectorsLoader_;
+    std::mutex mutex_;
+    std::condition_variable requestsCondition_;
+    Requests requests_;
+    std::atomic<uint64_t> generation_{0};
+    bool stopped_{false};
+    std::thread thread_;
+};
+
+#endif // SECTORPREFETCHER_HPP
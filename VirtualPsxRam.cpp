@@ -3,18 +3,92 @@
 #include <algorithm>
 #include <cstring>
 
+constexpr int VirtualPsxRam::NO_LAZY_LOAD;
+
 VirtualPsxRam::VirtualPsxRam()
+    : pagesLazyLoads_(PAGES_NUMBER, NO_LAZY_LOAD)
 { clear(); }
 
 void VirtualPsxRam::clear()
 {
+    snapshot_.drop();
+    snapshotInitializedRegions_.clear();
+    dropLazyLoads();
+    snapshotLazyLoadsNumber_ = 0;
     ram_.fill(0);
     initializedRegions_.clear();
 }
 
+void VirtualPsxRam::takeSnapshot()
+{
+    snapshot_.take();
+    snapshotInitializedRegions_ = initializedRegions_;
+    snapshotLazyLoadsNumber_ = lazyLoads_.size();
+}
+
+bool VirtualPsxRam::hasSnapshot() const
+{ return snapshot_.isTaken(); }
+
+void VirtualPsxRam::restoreSnapshot()
+{
+    if (!hasSnapshot())
+    { throw QString("No RAM snapshot to restore."); }
+    snapshot_.restore(ram_.data());
+    initializedRegions_ = snapshotInitializedRegions_;
+    // Pages of later lazy loads were saved before being registered, so they
+    // hold restored content now.
+    for (auto& pageLazyLoad : pagesLazyLoads_)
+    {
+        if (pageLazyLoad >= snapshotLazyLoadsNumber_)
+        {
+            pageLazyLoad = NO_LAZY_LOAD;
+            --pendingPagesNumber_;
+        }
+    }
+    lazyLoads_.resize(snapshotLazyLoadsNumber_);
+}
+
+void VirtualPsxRam::setAccessTracer(RamAccessTracer* accessTracer)
+{ accessTracer_ = accessTracer; }
+
+RamAccessTracer* VirtualPsxRam::accessTracer() const
+{ return accessTracer_; }
+
 QVector<PsxRamAddress::Region> const& VirtualPsxRam::initializedRegions() const
 { return initializedRegions_; }
 
+QVector<VirtualPsxRam::PendingRegion> VirtualPsxRam::pendingRegions() const
+{
+    QVector<PendingRegion> pendingRegions;
+    if (pendingPagesNumber_ == 0)
+    { return pendingRegions; }
+    uint32_t page = 0;
+    while (page < PAGES_NUMBER)
+    {
+        int lazyLoadIndex = pagesLazyLoads_[page];
+        if (lazyLoadIndex == NO_LAZY_LOAD)
+        {
+            ++page;
+            continue;
+        }
+        uint32_t runEnd = page + 1;
+        while (
+               runEnd < PAGES_NUMBER &&
+               pagesLazyLoads_[runEnd] == lazyLoadIndex)
+        { ++runEnd; }
+        auto const& lazyLoad = lazyLoads_[lazyLoadIndex];
+        uint32_t runAddress = page << PAGE_DEPTH;
+        pendingRegions.append({
+                                  {runAddress, (runEnd - page) << PAGE_DEPTH},
+                                  lazyLoad.dataId,
+                                  lazyLoad.dataOffset +
+                                      runAddress - lazyLoad.address
+                              });
+        page = runEnd;
+    }
+    return pendingRegions;
+}
+
 uint8_t VirtualPsxRam::readByte(PsxRamAddress address) const
 { return read<uint8_t>(address); }
 
@@ -39,6 +113,58 @@ PsxRamAddress VirtualPsxRam::readAddress(PsxRamAddress address) const
 void VirtualPsxRam::readRegion(
         PsxRamAddress::Region const& region,
         uint8_t* buffer) const
+{
+    std::memcpy(
+                buffer,
+                readableRegionPointer(
+                    region,
+                    RamAccessTracer::AccessType::Read),
+                region.size);
+}
+
+bool VirtualPsxRam::isInitializedRegion(
+        PsxRamAddress::Region const& region) const
+{
+    auto const* initializedRegion = findInitializedRegion(region.address);
+    return initializedRegion != nullptr &&
+            initializedRegion->doesContain(region);
+}
+
+PsxRamAddress::Region const* VirtualPsxRam::findInitializedRegion(
+        PsxRamAddress inPsxRamAddress) const
+{
+    // Regions are coalesced, so only the last region starting at or before
+    // the address can contain it.
+    auto startsAfter = [](
+            PsxRamAddress address,
+            PsxRamAddress::Region const& initializedRegion) {
+        return address < initializedRegion.address;
+    };
+    auto nextRegion = std::upper_bound(
+                initializedRegions_.cbegin(),
+                initializedRegions_.cend(),
+                inPsxRamAddress,
+                startsAfter);
+    if (nextRegion == initializedRegions_.cbegin())
+    { return nullptr; }
+    auto const* initializedRegion = &*(nextRegion - 1);
+    if (!initializedRegion->doesContain(inPsxRamAddress))
+    { return nullptr; }
+    return initializedRegion;
+}
+
+uint32_t VirtualPsxRam::initializedSizeFrom(PsxRamAddress address) const
+{
+    PsxRamAddress inPsxRamAddress = PsxRamConst::toNoSegRamAddress(address);
+    auto const* initializedRegion = findInitializedRegion(inPsxRamAddress);
+    if (initializedRegion == nullptr)
+    { return 0; }
+    return initializedRegion->end().raw() - inPsxRamAddress.raw() + 1;
+}
+
+uint8_t const* VirtualPsxRam::readableRegionPointer(
+        PsxRamAddress::Region const& region,
+        RamAccessTracer::AccessType accessType) const
 {
     PsxRamAddress inPsxRamAddress = PsxRamConst::toNoSegRamAddress(
                 region.address);
@@ -46,18 +172,9 @@ void VirtualPsxRam::readRegion(
     { throwReadOutOfBoundsError(region.address, region.size); }
     if (!isInitializedRegion({inPsxRamAddress, region.size}))
     { throwUnitializedReadError(region.address, region.size); }
-    std::memcpy(buffer, inBufferPointer(inPsxRamAddress), region.size);
-}
-
-bool VirtualPsxRam::isInitializedRegion(
-        PsxRamAddress::Region const& region) const
-{
-    for (auto const& initializedRegion : initializedRegions_)
-    {
-        if (initializedRegion.doesContain(region))
-        { return true; }
-    }
-    return false;
+    loadPendingPages(inPsxRamAddress, region.size);
+    traceAccess(accessType, inPsxRamAddress, region.size);
+    return inBufferPointer(inPsxRamAddress);
 }
 
 void VirtualPsxRam::writeByte(uint8_t byte, PsxRamAddress address)
@@ -85,12 +202,110 @@ void VirtualPsxRam::writeAddress(
 
 void VirtualPsxRam::load(QByteArray const& data, PsxRamAddress address)
 {
-    write(
+    load(
                 reinterpret_cast<uint8_t const*>(data.constData()),
                 data.size(),
                 address);
 }
 
+void VirtualPsxRam::load(
+        uint8_t const* data,
+        uint32_t dataSize,
+        PsxRamAddress address)
+{ write(data, dataSize, address); }
+
+void VirtualPsxRam::loadLazily(
+        PsxRamAddress address,
+        uint32_t size,
+        LazyDataId dataId,
+        LazyDataReader dataReader,
+        uint32_t dataOffset)
+{
+    PsxRamAddress inPsxRamAddress = PsxRamConst::toNoSegRamAddress(address);
+    if (!isInPsxRamRegion(inPsxRamAddress, size))
+    { throwWriteOutOfBoundsError(address, size); }
+    if (size == 0)
+    { return; }
+    uint32_t begin = inPsxRamAddress.raw();
+    uint32_t end = begin + size;
+    loadPendingPages(inPsxRamAddress, size);
+    snapshot_.prepareWrite(ram_.data(), begin, size);
+    uint32_t firstWholePage = (begin + PAGE_SIZE - 1) >> PAGE_DEPTH;
+    uint32_t wholePagesEnd = end >> PAGE_DEPTH;
+    if (firstWholePage >= wholePagesEnd)
+    {
+        dataReader(dataOffset, inBufferPointer(inPsxRamAddress), size);
+        initializeRegion({inPsxRamAddress, size});
+        return;
+    }
+    uint32_t wholePagesBegin = firstWholePage << PAGE_DEPTH;
+    uint32_t wholePagesEndAddress = wholePagesEnd << PAGE_DEPTH;
+    if (begin < wholePagesBegin)
+    {
+        dataReader(
+                    dataOffset,
+                    inBufferPointer(begin),
+                    wholePagesBegin - begin);
+    }
+    if (wholePagesEndAddress < end)
+    {
+        dataReader(
+                    dataOffset + wholePagesEndAddress - begin,
+                    inBufferPointer(wholePagesEndAddress),
+                    end - wholePagesEndAddress);
+    }
+    int lazyLoadIndex = lazyLoads_.size();
+    lazyLoads_.append({begin, size, dataId, std::move(dataReader), dataOffset});
+    for (uint32_t page = firstWholePage; page < wholePagesEnd; ++page)
+    {
+        if (pagesLazyLoads_[page] == NO_LAZY_LOAD)
+        { ++pendingPagesNumber_; }
+        pagesLazyLoads_[page] = lazyLoadIndex;
+    }
+    initializeRegion({inPsxRamAddress, size});
+}
+
+void VirtualPsxRam::loadPendingPagesInRange(
+        uint32_t inPsxRamAddress,
+        uint32_t size) const
+{
+    // Pages are filled only in const accessors, contents of initialized
+    // region don't change from the outside point of view.
+    auto* ram = const_cast<uint8_t*>(ram_.data());
+    uint32_t lastPage = (inPsxRamAddress + size - 1) >> PAGE_DEPTH;
+    uint32_t page = inPsxRamAddress >> PAGE_DEPTH;
+    while (page <= lastPage)
+    {
+        int lazyLoadIndex = pagesLazyLoads_[page];
+        if (lazyLoadIndex == NO_LAZY_LOAD)
+        {
+            ++page;
+            continue;
+        }
+        // Consecutive pages of the same load are read at once.
+        uint32_t runEnd = page + 1;
+        while (runEnd <= lastPage && pagesLazyLoads_[runEnd] == lazyLoadIndex)
+        { ++runEnd; }
+        auto const& lazyLoad = lazyLoads_[lazyLoadIndex];
+        uint32_t runAddress = page << PAGE_DEPTH;
+        uint32_t runPagesNumber = runEnd - page;
+        lazyLoad.dataReader(
+                    lazyLoad.dataOffset + runAddress - lazyLoad.address,
+                    ram + runAddress,
+                    runPagesNumber << PAGE_DEPTH);
+        for (; page < runEnd; ++page)
+        { pagesLazyLoads_[page] = NO_LAZY_LOAD; }
+        pendingPagesNumber_ -= runPagesNumber;
+    }
+}
+
+void VirtualPsxRam::dropLazyLoads()
+{
+    std::fill(pagesLazyLoads_.begin(), pagesLazyLoads_.end(), NO_LAZY_LOAD);
+    pendingPagesNumber_ = 0;
+    lazyLoads_.clear();
+}
+
 void VirtualPsxRam::write(
         uint8_t const* bytes,
         uint32_t bytesNumber,
@@ -99,6 +314,12 @@ void VirtualPsxRam::write(
     PsxRamAddress inPsxRamAddress = PsxRamConst::toNoSegRamAddress(address);
     if (!isInPsxRamRegion(inPsxRamAddress, bytesNumber))
     { throwWriteOutOfBoundsError(address, bytesNumber); }
+    loadPendingPages(inPsxRamAddress, bytesNumber);
+    snapshot_.prepareWrite(ram_.data(), inPsxRamAddress.raw(), bytesNumber);
+    traceAccess(
+                RamAccessTracer::AccessType::Write,
+                inPsxRamAddress,
+                bytesNumber);
     std::memcpy(inBufferPointer(inPsxRamAddress), bytes, bytesNumber);
     initializeRegion({inPsxRamAddress, bytesNumber});
 }
@@ -120,36 +341,40 @@ uint8_t const* VirtualPsxRam::inBufferPointer(PsxRamAddress address) const
 
 void VirtualPsxRam::initializeRegion(PsxRamAddress::Region const& region)
 {
-    for (int i = 0; i < initializedRegions_.size(); ++i)
+    if (region.size == 0)
+    { return; }
+    uint32_t begin = region.address.raw();
+    uint32_t end = begin + region.size;
+    // First region which is not before the new one, adjacent regions are
+    // merged too.
+    auto endsBefore = [](
+            PsxRamAddress::Region const& initializedRegion,
+            uint32_t address) {
+        return initializedRegion.address.raw() + initializedRegion.size <
+                address;
+    };
+    int firstIndex = std::lower_bound(
+                initializedRegions_.cbegin(),
+                initializedRegions_.cend(),
+                begin,
+                endsBefore) - initializedRegions_.cbegin();
+    int lastIndex = firstIndex;
+    while (
+           lastIndex < initializedRegions_.size() &&
+           initializedRegions_[lastIndex].address.raw() <= end)
     {
-        auto& initializedRegion = initializedRegions_[i];
-        if (initializedRegion.doesContain(region))
-        { return; }
-        if (region.doesContain(initializedRegion))
-        {
-            initializedRegion = region;
-            return;
-        }
-        if (
-                initializedRegion.doesIntersect(region) ||
-                initializedRegion.isAdjacent(region))
-        {
-            auto startAddress =
-                    initializedRegion.address <= region.address ?
-                        initializedRegion.address :
-                        region.address;
-            auto endAddress = initializedRegion.end() >= region.end() ?
-                        initializedRegion.end() :
-                        region.end();
-            uint32_t size =
-                    endAddress > startAddress ?
-                        endAddress - startAddress + 1 :
-                        0;
-            initializedRegion = {startAddress, size};
-            return;
-        }
+        auto const& mergedRegion = initializedRegions_[lastIndex];
+        begin = std::min(begin, mergedRegion.address.raw());
+        end = std::max(end, mergedRegion.address.raw() + mergedRegion.size);
+        ++lastIndex;
+    }
+    if (firstIndex == lastIndex)
+    {
+        initializedRegions_.insert(firstIndex, {begin, end - begin});
+        return;
     }
-    initializedRegions_.append(region);
+    initializedRegions_[firstIndex] = {begin, end - begin};
+    initializedRegions_.remove(firstIndex + 1, lastIndex - firstIndex - 1);
 }
 
 void VirtualPsxRam::throwReadOutOfBoundsError(
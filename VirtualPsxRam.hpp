@@ -1,21 +1,60 @@
 #ifndef VIRTUALPSXRAM_HPP
 #define VIRTUALPSXRAM_HPP
 
+#include "MemoryPagesSnapshot.hpp"
 #include "PsxRamAddress.hpp"
 #include "PsxRamConst.hpp"
+#include "PsxRamView.hpp"
+#include "RamAccessTracer.hpp"
 #include <QString>
 #include <QVector>
 #include <array>
+#include <functional>
+#include <vector>
 
 class VirtualPsxRam
 {
     using PsxRamBuffer = std::array<uint8_t, PsxRamConst::SIZE>;
+    static constexpr uint8_t PAGE_DEPTH = 12;
+    static constexpr uint32_t PAGE_SIZE = 1 << PAGE_DEPTH;
+    static constexpr uint32_t PAGES_NUMBER = PsxRamConst::SIZE >> PAGE_DEPTH;
+    static constexpr int NO_LAZY_LOAD = -1;
 
 public:
+    // Identifies data read by a lazy load, e.g. its first disc sector, so
+    // that pending pages can be persisted as a reference to the data.
+    using LazyDataId = uint32_t;
+    // Copies size bytes of identified data starting at dataOffset into
+    // buffer.
+    using LazyDataReader = std::function<void(
+            uint32_t dataOffset,
+            uint8_t* buffer,
+            uint32_t size)>;
+
+    // Whole pages not read yet, all of them from the same lazy load.
+    struct PendingRegion
+    {
+        PsxRamAddress::Region region;
+        LazyDataId dataId;
+        // Offset of region's first byte in identified data.
+        uint32_t dataOffset;
+    };
+
     VirtualPsxRam();
 
+    // Also drops snapshot.
     void clear();
+    // Later restoreSnapshot() reverts only pages written in between.
+    void takeSnapshot();
+    bool hasSnapshot() const;
+    void restoreSnapshot();
+    // Null tracer (default) disables tracing. Tracer is not owned.
+    void setAccessTracer(RamAccessTracer* accessTracer);
+    RamAccessTracer* accessTracer() const;
+    // Sorted by address, neither overlapping nor adjacent.
     QVector<PsxRamAddress::Region> const& initializedRegions() const;
+    // Sorted by address, each of them is inside an initialized region.
+    QVector<PendingRegion> pendingRegions() const;
     uint8_t readByte(PsxRamAddress address) const;
     int8_t readSBbyte(PsxRamAddress address) const;
     uint16_t readWord(PsxRamAddress address) const;
@@ -24,6 +63,56 @@ public:
     int32_t readSDWord(PsxRamAddress address) const;
     PsxRamAddress readAddress(PsxRamAddress address) const;
     void readRegion(PsxRamAddress::Region const& region, uint8_t* buffer) const;
+    template <typename T>
+    T const& viewObject(PsxRamAddress address) const
+    { return *view<T>(address, 1).begin(); }
+    template <typename T>
+    PsxRamView<T> view(PsxRamAddress address, uint32_t count) const
+    {
+        uint32_t size = count * static_cast<uint32_t>(sizeof(T));
+        return {
+            reinterpret_cast<T const*>(
+                        readableRegionPointer(
+                            {address, size},
+                            RamAccessTracer::AccessType::View)),
+            count,
+            address
+        };
+    }
+    // Views table which ends with an element for which isLast returns true,
+    // or after maxSize elements. Only memory of the table is loaded.
+    template <typename T, typename IsLast>
+    PsxRamView<T> viewTable(
+            PsxRamAddress address,
+            IsLast isLast,
+            uint32_t maxSize = static_cast<uint32_t>(-1)) const
+    {
+        constexpr uint32_t const elementSize = sizeof(T);
+        PsxRamAddress inPsxRamAddress = PsxRamConst::toNoSegRamAddress(
+                    address);
+        uint32_t availableSize = initializedSizeFrom(address) / elementSize;
+        auto const* elements = reinterpret_cast<T const*>(
+                    inBufferPointer(inPsxRamAddress));
+        uint32_t size = 0;
+        while (size < maxSize)
+        {
+            if (size == availableSize)
+            {
+                throwUnitializedReadError(
+                            address + size * elementSize,
+                            elementSize);
+            }
+            loadPendingPages(inPsxRamAddress + size * elementSize, elementSize);
+            ++size;
+            if (isLast(elements[size - 1]))
+            { break; }
+        }
+        traceAccess(
+                    RamAccessTracer::AccessType::View,
+                    inPsxRamAddress,
+                    size * elementSize);
+        return {elements, size, address};
+    }
     void writeByte(uint8_t byte, PsxRamAddress address);
     void writeSByte(int8_t sbyte, PsxRamAddress address);
     void writeWord(uint16_t word, PsxRamAddress address);
@@ -34,6 +123,16 @@ public:
             PsxRamAddress addressToWrite,
             PsxRamAddress addressToWriteTo);
     void load(QByteArray const& data, PsxRamAddress address);
+    void load(uint8_t const* data, uint32_t dataSize, PsxRamAddress address);
+    // Region is initialized at once, but its pages are read with dataReader
+    // on first access. Pages shared with other data are read right away.
+    // Region holds identified data starting at dataOffset.
+    void loadLazily(
+            PsxRamAddress address,
+            uint32_t size,
+            LazyDataId dataId,
+            LazyDataReader dataReader,
+            uint32_t dataOffset = 0);
 
 private:
     constexpr std::size_t size() const
@@ -48,12 +147,37 @@ private:
         { throwReadOutOfBoundsError(address, size); }
         if (!isInitializedRegion({inPsxRamAddress, size}))
         { throwUnitializedReadError(inPsxRamAddress, size); }
+        loadPendingPages(inPsxRamAddress, size);
+        traceAccess(RamAccessTracer::AccessType::Read, inPsxRamAddress, size);
         return *reinterpret_cast<T const*>(inBufferPointer(inPsxRamAddress));
     }
+    inline void traceAccess(
+            RamAccessTracer::AccessType type,
+            PsxRamAddress inPsxRamAddress,
+            uint32_t size) const
+    {
+        if (accessTracer_ != nullptr)
+        { accessTracer_->record(type, inPsxRamAddress.raw(), size); }
+    }
+    inline void loadPendingPages(
+            PsxRamAddress inPsxRamAddress,
+            uint32_t size) const
+    {
+        if (pendingPagesNumber_ > 0 && size > 0)
+        { loadPendingPagesInRange(inPsxRamAddress.raw(), size); }
+    }
+    void loadPendingPagesInRange(uint32_t inPsxRamAddress, uint32_t size) const;
+    void dropLazyLoads();
     bool isInitializedRegion(PsxRamAddress::Region const& region) const;
+    PsxRamAddress::Region const* findInitializedRegion(
+            PsxRamAddress inPsxRamAddress) const;
+    uint32_t initializedSizeFrom(PsxRamAddress address) const;
+    uint8_t const* readableRegionPointer(
+            PsxRamAddress::Region const& region,
+            RamAccessTracer::AccessType accessType) const;
     template <typename T>
     void write(T t, PsxRamAddress address)
-    { write(reinterpret_cast<uint8_t const*>(t), sizeof(t), address); }
+    { write(reinterpret_cast<uint8_t const*>(&t), sizeof(t), address); }
     void write(
             uint8_t const* bytes,
             uint32_t bytesNumber,
@@ -72,6 +196,22 @@ private:
 
     PsxRamBuffer ram_;
     QVector<PsxRamAddress::Region> initializedRegions_;
+    MemoryPagesSnapshot snapshot_{PsxRamConst::SIZE};
+    QVector<PsxRamAddress::Region> snapshotInitializedRegions_;
+    struct LazyLoad
+    {
+        uint32_t address;
+        uint32_t size;
+        LazyDataId dataId;
+        LazyDataReader dataReader;
+        uint32_t dataOffset;
+    };
+    QVector<LazyLoad> lazyLoads_;
+    int snapshotLazyLoadsNumber_{0};
+    // Index of lazy load which fills page on first access.
+    mutable std::vector<int> pagesLazyLoads_;
+    mutable uint32_t pendingPagesNumber_{0};
+    RamAccessTracer* accessTracer_{nullptr};
 };
 
 #endif // VIRTUALPSXRAM_HPP
@@ -1,16 +1,94 @@
 #include "VirtualPsxVRam.hpp"
 
+#include <QtEndian>
 #include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 constexpr VirtualPsxVRam::ColorMapping VirtualPsxVRam::COLOR_MAPPING;
 
+namespace
+{
+
+static constexpr QRgb OPAQUE_ALPHA = 0xff000000;
+
+template <bool isOpaque>
+void convert16BppRow(
+        QRgb const* lut,
+        uint8_t const* vramRow,
+        QRgb* imageRow,
+        int pixelsNumber)
+{
+    // Opaque colors differ from transparent black ones only in alpha of
+    // pixel value 0.
+    int x = 0;
+#ifdef __SSE2__
+    // SSE2 has no gather, so pixels are looked up one by one, but they are
+    // loaded and stored 8 at a time.
+    __m128i const alpha = _mm_set1_epi32(
+                isOpaque ? static_cast<int>(OPAQUE_ALPHA) : 0);
+    for (; x + 8 <= pixelsNumber; x += 8)
+    {
+        __m128i pixels = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(vramRow + x * 2));
+        __m128i lowArgbs = _mm_setr_epi32(
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 0)]),
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 1)]),
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 2)]),
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 3)]));
+        __m128i highArgbs = _mm_setr_epi32(
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 4)]),
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 5)]),
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 6)]),
+                    static_cast<int>(lut[_mm_extract_epi16(pixels, 7)]));
+        _mm_storeu_si128(
+                    reinterpret_cast<__m128i*>(imageRow + x),
+                    _mm_or_si128(lowArgbs, alpha));
+        _mm_storeu_si128(
+                    reinterpret_cast<__m128i*>(imageRow + x + 4),
+                    _mm_or_si128(highArgbs, alpha));
+    }
+#endif
+    for (; x < pixelsNumber; ++x)
+    {
+        QRgb argb = lut[qFromLittleEndian<uint16_t>(vramRow + x * 2)];
+        imageRow[x] = isOpaque ? argb | OPAQUE_ALPHA : argb;
+    }
+}
+
+} // namespace
+
 VirtualPsxVRam::VirtualPsxVRam()
 { clear(); }
 
 void VirtualPsxVRam::clear()
 {
+    snapshot_.drop();
+    snapshotInitializedRects_.clear();
+    snapshotInitializedBoundingRect_ = QRect();
     vram_.fill(0);
     initializedRects_.clear();
+    initializedBoundingRect_ = QRect();
+}
+
+void VirtualPsxVRam::takeSnapshot()
+{
+    snapshot_.take();
+    snapshotInitializedRects_ = initializedRects_;
+    snapshotInitializedBoundingRect_ = initializedBoundingRect_;
+}
+
+bool VirtualPsxVRam::hasSnapshot() const
+{ return snapshot_.isTaken(); }
+
+void VirtualPsxVRam::restoreSnapshot()
+{
+    if (!hasSnapshot())
+    { throw QString("No VRAM snapshot to restore."); }
+    snapshot_.restore(vram_.data());
+    initializedRects_ = snapshotInitializedRects_;
+    initializedBoundingRect_ = snapshotInitializedBoundingRect_;
 }
 
 QVector<QRect> const& VirtualPsxVRam::initializedRects() const
@@ -25,24 +103,12 @@ QImage VirtualPsxVRam::asImage() const
                 PsxVRamConst::PIXELS_PER_LINE,
                 PsxVRamConst::HEIGHT,
                 QImage::Format_ARGB32);
-    int x = 0;
-    int y = 0;
-    QRgb* imagePixelAddress = reinterpret_cast<QRgb*>(image.scanLine(y));
-    for (
-         auto it = vram_.cbegin();
-         it != vram_.cend();
-         it += PsxVRamConst::PIXEL_SIZE)
+    for (int y = 0; y < image.height(); ++y)
     {
-        *imagePixelAddress = read16BppPixel(it).toRgb();
-        ++x;
-        if (x < image.width())
-        { ++imagePixelAddress; }
-        else
-        {
-            x = 0;
-            ++y;
-            imagePixelAddress = reinterpret_cast<QRgb*>(image.scanLine(y));
-        }
+        convert16BppRowToOpaque(
+                    scanLine(y),
+                    reinterpret_cast<QRgb*>(image.scanLine(y)),
+                    image.width());
     }
     return image;
 }
@@ -64,14 +130,10 @@ QImage VirtualPsxVRam::read16BppTexture(QRect const& rect) const
     QImage image(rect.width(), rect.height(), QImage::Format_ARGB32);
     for (int y = 0; y < image.height(); ++y)
     {
-        QRgb* imagePixelAddress = reinterpret_cast<QRgb*>(image.scanLine(y));
-        uint8_t const* vramPixelAddress = pixelAddress(rect.x(), rect.y() + y);
-        for (int x = 0; x < image.width(); ++x)
-        {
-            *imagePixelAddress = read16BppPixel(vramPixelAddress).toRgba();
-            ++imagePixelAddress;
-            vramPixelAddress += PsxVRamConst::PIXEL_SIZE;
-        }
+        convert16BppRowToTransparentBlack(
+                    pixelAddress(rect.x(), rect.y() + y),
+                    reinterpret_cast<QRgb*>(image.scanLine(y)),
+                    image.width());
     }
     return image;
 }
@@ -206,7 +268,7 @@ uint8_t* VirtualPsxVRam::scanLine(int y)
 { return vram_.begin() + (y << PsxVRamConst::WIDTH_DEPTH); }
 
 VirtualPsxVRam::Pixel16Bpp VirtualPsxVRam::read16BppPixel(
-        uint8_t const* pixelAddress) const
+        uint8_t const* pixelAddress)
 {
     Pixel16Bpp pixel;
     uint8_t byte1 = *pixelAddress;
@@ -219,6 +281,58 @@ VirtualPsxVRam::Pixel16Bpp VirtualPsxVRam::read16BppPixel(
     return pixel;
 }
 
+VirtualPsxVRam::PixelsArgbLut const& VirtualPsxVRam::pixelsArgbLut()
+{
+    static PixelsArgbLut const PIXELS_ARGB_LUT = []() {
+        PixelsArgbLut lut;
+        for (uint32_t value = 0; value < lut.size(); ++value)
+        {
+            uint8_t pixel[PsxVRamConst::PIXEL_SIZE];
+            qToLittleEndian<uint16_t>(value, pixel);
+            lut[value] = read16BppPixel(pixel).toRgba();
+        }
+        return lut;
+    }();
+    return PIXELS_ARGB_LUT;
+}
+
+void VirtualPsxVRam::convert16BppRowToOpaque(
+        uint8_t const* vramRow,
+        QRgb* imageRow,
+        int pixelsNumber)
+{
+    convert16BppRow<true>(
+                pixelsArgbLut().data(),
+                vramRow,
+                imageRow,
+                pixelsNumber);
+}
+
+void VirtualPsxVRam::convert16BppRowToTransparentBlack(
+        uint8_t const* vramRow,
+        QRgb* imageRow,
+        int pixelsNumber)
+{
+    convert16BppRow<false>(
+                pixelsArgbLut().data(),
+                vramRow,
+                imageRow,
+                pixelsNumber);
+}
+
+void VirtualPsxVRam::readRect(QRect const& rect, uint8_t* buffer) const
+{
+    assertRectInVRam(rect);
+    if (!isRectInitialized(rect))
+    { throwUninitializedRectError(rect, "raw pixels"); }
+    auto scanLineDataSize = rect.width() * PsxVRamConst::PIXEL_SIZE;
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        std::memcpy(buffer, pixelAddress(rect.x(), y), scanLineDataSize);
+        buffer += scanLineDataSize;
+    }
+}
+
 void VirtualPsxVRam::load(QByteArray const& data, QRect const& rect)
 { load(reinterpret_cast<uint8_t const*>(data.constData()), data.size(), rect); }
 
@@ -226,6 +340,75 @@ void VirtualPsxVRam::load(
         uint8_t const* data,
         uint32_t dataSize,
         QRect const& rect)
+{
+    assertRectInVRam(rect);
+    auto scanLineDataSize = rect.width() * PsxVRamConst::PIXEL_SIZE;
+    uint32_t expectedDataSize = scanLineDataSize * rect.height();
+    if (dataSize != expectedDataSize)
+    {
+        throw QString(
+                    "With rect (%1, %2)(%3, %4) expected data size is 0x%5. "
+                    "Provided data size 0x%6.")
+                .arg(rect.left())
+                .arg(rect.top())
+                .arg(rect.right())
+                .arg(rect.bottom())
+                .arg(expectedDataSize, 0, 16)
+                .arg(dataSize, 0, 16);
+    }
+    // Copying can't fail, so rect isn't backed up.
+    writeRect(rect, [&](uint8_t* rectData, uint32_t rowStride) {
+        auto* dataStartIt = data;
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            auto* dataEndIt = dataStartIt + scanLineDataSize;
+            std::copy(dataStartIt, dataEndIt, rectData + y * rowStride);
+            dataStartIt = dataEndIt;
+        }
+    });
+}
+
+void VirtualPsxVRam::load(QRect const& rect, RectLoader const& rectLoader)
+{
+    assertRectInVRam(rect);
+    auto scanLineDataSize = rect.width() * PsxVRamConst::PIXEL_SIZE;
+    // Rect may be not initialized yet, so it's copied without readRect.
+    rectBackup_.resize(scanLineDataSize * rect.height());
+    auto* backupRow = rectBackup_.data();
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        std::memcpy(backupRow, pixelAddress(rect.x(), y), scanLineDataSize);
+        backupRow += scanLineDataSize;
+    }
+    try
+    { writeRect(rect, rectLoader); }
+    catch (...)
+    {
+        backupRow = rectBackup_.data();
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            std::memcpy(pixelAddress(rect.x(), y), backupRow, scanLineDataSize);
+            backupRow += scanLineDataSize;
+        }
+        throw;
+    }
+}
+
+void VirtualPsxVRam::writeRect(QRect const& rect, RectLoader const& rectLoader)
+{
+    // Rows of rect are spread over whole pages, so pages range between its
+    // first and last byte is written anyway.
+    auto const* rectBegin = pixelAddress(rect.x(), rect.y());
+    auto const* rectEnd = pixelAddress(rect.right() + 1, rect.bottom());
+    snapshot_.prepareWrite(
+                vram_.data(),
+                static_cast<uint32_t>(rectBegin - vram_.data()),
+                static_cast<uint32_t>(rectEnd - rectBegin));
+    rectLoader(pixelAddress(rect.x(), rect.y()), PsxVRamConst::WIDTH);
+    appendInitializedRect(rect);
+}
+
+void VirtualPsxVRam::assertRectInVRam(QRect const& rect) const
 {
     if (rect.isEmpty())
     {
@@ -245,29 +428,6 @@ void VirtualPsxVRam::load(
                 .arg(rect.right())
                 .arg(rect.bottom());
     }
-    auto scanLineDataSize = rect.width() * PsxVRamConst::PIXEL_SIZE;
-    uint32_t expectedDataSize = scanLineDataSize * rect.height();
-    if (dataSize != expectedDataSize)
-    {
-        throw QString(
-                    "With rect (%1, %2)(%3, %4) expected data size is 0x%5. "
-                    "Provided data size 0x%6.")
-                .arg(rect.left())
-                .arg(rect.top())
-                .arg(rect.right())
-                .arg(rect.bottom())
-                .arg(expectedDataSize, 0, 16)
-                .arg(dataSize, 0, 16);
-    }
-    auto* dataStartIt = data;
-    for (int y = rect.y(); y <= rect.bottom(); ++y)
-    {
-        auto* dataEndIt = dataStartIt + scanLineDataSize;
-        auto* vramPixel = pixelAddress(rect.x(), y);
-        std::copy(dataStartIt, dataEndIt, vramPixel);
-        dataStartIt = dataEndIt;
-    }
-    appendInitializedRect(rect);
 }
 
 void VirtualPsxVRam::appendInitializedRect(QRect const& rect)
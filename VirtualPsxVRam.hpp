@@ -2,9 +2,11 @@
 #define VIRTUALPSXVRAM_HPP
 
 #include "AdDefinitions.hpp"
+#include "MemoryPagesSnapshot.hpp"
 #include "PsxVRamConst.hpp"
 #include <QImage>
 #include <array>
+#include <vector>
 
 class VirtualPsxVRam
 {
@@ -32,6 +34,9 @@ private:
         227, 231, 235, 239, 243, 247, 251, 255
     };
     using PsxVRamBuffer = std::array<uint8_t, PsxVRamConst::SIZE>;
+    // ARGB32 color of every 16 Bpp pixel value, black pixels without
+    // semi-transparency flag are transparent.
+    using PixelsArgbLut = std::array<QRgb, valuesInBits(16)>;
 
     struct Pixel16Bpp
     {
@@ -66,6 +71,12 @@ private:
     };
 
 public:
+    // Writes rect data directly into VRAM. It gets address of rect's top left
+    // pixel and distance between rect rows in bytes. If it throws, e.g. on
+    // corrupt packed data, rect is restored to its previous content.
+    using RectLoader =
+            std::function<void(uint8_t* rectData, uint32_t rowStride)>;
+
     static QSize const TEXTURE_PAGE_SIZE;
 
     VirtualPsxVRam();
@@ -73,7 +84,12 @@ public:
     constexpr std::size_t size() const
     { return vram_.size(); }
 
+    // Also drops snapshot.
     void clear();
+    // Later restoreSnapshot() reverts only pages written in between.
+    void takeSnapshot();
+    bool hasSnapshot() const;
+    void restoreSnapshot();
     QVector<QRect> const& initializedRects() const;
     QRect const& initializedBoundingRect() const;
     QImage asImage() const;
@@ -91,8 +107,11 @@ public:
     void read4BppPalette(QPoint const& point, Palette4Bpp& palette) const;
     void read8BppPalette(Clut const& clut, Palette8Bpp& palette) const;
     void read8BppPalette(QPoint const& point, Palette8Bpp& palette) const;
+    // Copies raw pixels of rect, rows follow each other without gaps.
+    void readRect(QRect const& rect, uint8_t* buffer) const;
     void load(QByteArray const& data, QRect const& rect);
     void load(uint8_t const* data, uint32_t dataSize, QRect const& rect);
+    void load(QRect const& rect, RectLoader const& rectLoader);
     static QRect calculateVRamRect(Graphic const& graphic);
 
 private:
@@ -120,11 +139,10 @@ private:
         }
         uint8_t const* vramPixelAddress =
                 pixelAddress(vramPoint.x(), vramPoint.y());
-        for (uint32_t index = 0; index < PALETTE_SIZE; ++index)
-        {
-            palette.data[index] = read16BppPixel(vramPixelAddress).toRgba();
-            vramPixelAddress += PsxVRamConst::PIXEL_SIZE;
-        }
+        convert16BppRowToTransparentBlack(
+                    vramPixelAddress,
+                    palette.data.data(),
+                    PALETTE_SIZE);
     }
     void assertTextureDepth(Texpage const& texpage, TexpageBpp expected) const;
     QPoint clutToVRamPoint(Clut const& clut) const;
@@ -132,7 +150,19 @@ private:
     uint8_t const* scanLine(int y) const;
     uint8_t* pixelAddress(int x, int y);
     uint8_t* scanLine(int y);
-    Pixel16Bpp read16BppPixel(uint8_t const* pixelAddress) const;
+    static Pixel16Bpp read16BppPixel(uint8_t const* pixelAddress);
+    static PixelsArgbLut const& pixelsArgbLut();
+    // Converts a row of 16 Bpp pixels to ARGB32, ignoring transparency.
+    static void convert16BppRowToOpaque(
+            uint8_t const* vramRow,
+            QRgb* imageRow,
+            int pixelsNumber);
+    static void convert16BppRowToTransparentBlack(
+            uint8_t const* vramRow,
+            QRgb* imageRow,
+            int pixelsNumber);
+    void writeRect(QRect const& rect, RectLoader const& rectLoader);
+    void assertRectInVRam(QRect const& rect) const;
     void appendInitializedRect(QRect const& rect);
     bool isRectInitialized(QRect const& rect) const;
     bool isPointInitialized(QPoint const& point) const;
@@ -145,6 +175,11 @@ private:
     PsxVRamBuffer vram_;
     QVector<QRect> initializedRects_;
     QRect initializedBoundingRect_;
+    MemoryPagesSnapshot snapshot_{PsxVRamConst::SIZE};
+    QVector<QRect> snapshotInitializedRects_;
+    QRect snapshotInitializedBoundingRect_;
+    // Previous content of rect being loaded, kept to avoid reallocations.
+    std::vector<uint8_t> rectBackup_;
 };
 
 #endif // VIRTUALPSXVRAM_HPP